@@ -8,6 +8,10 @@
  *  Summary:   This is the main code file for the ADF4351 PLL setup application
  *
  *  File scope revision history:
+ *    10-17-26 jmh:  CH_LOG builds only reserve the channel sectors (the log is formatted at boot).
+ *						So do CH_POOL builds (the records and pool can't be built at compile time), and CH_FREQ.
+ *						CH_LOG/CH_POOL/CH_FREQ builds emit no channel data at all (a partly initialized
+ *						placeholder was zero filled by the compiler, which left every pool slot used).
  *    10-20-19 jmh:  Created custom file for K7AYP
  *    04-29-17 jmh:  Rev 1.2:
  *					 Added #if build option to support NUM_CHAN such that only the required number of channels
@@ -38,6 +42,12 @@
 	//	0xFFFFFFFF is the implicit value of a register location assuming that the FLASH bytes are in the erased state.
 	//
 	// These register data are for an Orion-I with 10 MHz ref osc, and set -4dBm output level:
+#if (CH_LOG == 1) || (CH_POOL == 1) || (CH_FREQ == 1)
+	// CH_LOG/CH_POOL/CH_FREQ: the channel sectors hold the CH record log (chlog.c), the pooled CH
+	//	records (chpool.c), or the frequency records (chfreq.c).  They must be left erased, so no
+	//	data is placed there (the IROM limit of 0x1200 keeps code out of them).  Remove
+	//	"?CO?CHANNELS(0x1280)" from BL51 Locate for these builds (the segment is empty).
+#else
 	U32 code pll_ch_array[] = {
 
 	//	        R0          R1          R2          R3          R4          R5		// ADF reg#s
@@ -434,3 +444,4 @@
 		0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,		// null channel
 #endif
 	};
+#endif
@@ -13,6 +13,12 @@
 /********************************************************************
  *  File scope declarations revision history:
  *    04-29-16 jmh:  creation date
+ *    10-17-26 jmh:  Added CHS_NSECT, NUM_SECT, and CH_SECT() (CH sector layout derived from NUM_CHAN)
+ *						Added CH_REC, POOL_ADDR, and CHS_FLAT for the pooled CH format (CH_POOL)
+ *						Added the frequency CH format (CH_FREQ) and CHS_PACK
+ *						Added the unit config log (CFG_ADDR)
+ *						CFG_LEN is the scratch sector for CH_LOG (the config image has grown)
+ *						Added LOCK_ADDR.  The CH_LOG config log stops short of it.
  *
  *******************************************************************/
 
@@ -22,12 +28,55 @@
 #define	CHAN_ADDR	0x1280
 #define	SECT00_ADDR	0x1200
 #define	SECTOR_SIZE	512
+// the gap between SECT00_ADDR and CHAN_ADDR (erased with sector 0)
+#define	CRCLOG_ADDR	0x1200			// table CRC16 log (chstore.c)
+#define	CRCLOG_LEN	64
+#define	JRNL_ADDR	0x1240			// CH re-write journal (chstore.c)
+#define	JRNL_LEN	64
+#define	SCRATCH_ADDR 0x1C00			// CH re-write scratch sector (CH_RWR, reserved at link)
+#define	LOCK_ADDR	0x1DFF			// F53x FLASH lock byte (the last byte of the scratch sector, never written)
+// CH records at CHAN_ADDR.  CH_POOL: R0, R1, then a pool index for each of R2-R5,
+//	with the pool (POOL_NUM regs) after the last record (chpool.c).  CH_FREQ: frequency
+//	and opt, the regs are synthesized (chfreq.c).
+#define	CHS_PACK	((CH_POOL == 1) || (CH_FREQ == 1))	// CH records are expanded by chs_chan()
+#define	CHS_FLAT	((CH_LOG == 0) && !CHS_PACK)		// CH table is the 24 byte CHs at CHAN_ADDR
+#if (CH_POOL == 1)
+#define	CH_REC		12				// CH record size
+#define	POOL_NUM	32				// # pool entries (max 254)
+#elif (CH_FREQ == 1)
+#define	CH_REC		5
+#define	POOL_NUM	0
+#else
+#define	CH_REC		24
+#define	POOL_NUM	0
+#endif
+#define	POOL_ADDR	(CHAN_ADDR + (CH_REC * NUM_CHAN))
+// CH sectors (the layout is checked in chstore.c)
+#define	CHS_NSECT	((SCRATCH_ADDR - SECT00_ADDR) / SECTOR_SIZE)	// # sectors reserved for CHs (5)
+#if (CH_LOG == 1)
+#define	NUM_SECT	CHS_NSECT		// the log uses all of them
+#else
+#define	NUM_SECT	((POOL_ADDR + (4 * POOL_NUM) - SECT00_ADDR + SECTOR_SIZE - 1) / SECTOR_SIZE)	// # sectors used by NUM_CHAN CHs
+#endif
+#define	CH_SECT(off) ((U8)((CHAN_ADDR - SECT00_ADDR + (off)) / SECTOR_SIZE))	// sector# that holds table byte off
+// unit config log (ref ppm correction and reg overlays, chstore.c): the end of the last CH sector
+//	(CH_LOG: the scratch sector, which the log doesn't use)
+#if (CH_LOG == 1)
+#define	CFG_LEN		(SECTOR_SIZE - 1)	// (not the lock byte)
+#define	CFG_ADDR	SCRATCH_ADDR
+#else
+#define	CFG_LEN		32
+#define	CFG_ADDR	(SCRATCH_ADDR - CFG_LEN)
+#endif
+#define	CFG_SECT	((U8)((CFG_ADDR - SECT00_ADDR) / SECTOR_SIZE))	// sector# of the config log
 
 //------------------------------------------------------------------------------
 // public Function Prototypes
 //------------------------------------------------------------------------------
 
+#if CHS_FLAT
 extern U32 code pll_ch_array[];
+#endif
 
 //------------------------------------------------------------------------------
 // global defines
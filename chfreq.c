@@ -0,0 +1,147 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chfreq.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the frequency channel record format (CH_FREQ = 1).  A
+ *             channel record holds the output frequency and the syn_calc()
+ *             opt (power and flags) only (CH_REC bytes vs 24), and the regs
+ *             are synthesized (synth.c) when the CH is read.  A SYN_REF
+ *             change only needs a re-build, not a new CH table.
+ *
+ *			   Record: frequency (U32, 10 Hz units, MSB 1st), opt (U8).  An erased record
+ *			   (or one that syn_calc() rejects) is an empty CH.  chf_pack() only takes a CH that
+ *			   re-synthesizes to the same 24 bytes (one made by "F" at the default spacing, or a
+ *			   table CH in the same form); anything else can't be stored in this format.
+ *
+ *			   The PTT pair is cached: chf_buf[0] holds CH00 (PTT active), and chf_buf[1] the
+ *			   last other CH read, so a PTT or FSEL change back to a cached CH doesn't re-synthesize.
+ *			   chstore.c does the record writes/re-writes and keeps the table CRC16 over the
+ *			   synthesized (24 byte) CHs, so the CH table looks the same to the host.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "channels.h"
+#include "synth.h"
+#define CHFREQ_INCL
+#include "chfreq.h"
+
+#if (CH_FREQ == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	CHF_NONE	0xFF				// chf_ch1: chf_buf[1] is empty
+
+#if (CH_REC != 5)
+#error "CH_FREQ: record is 5 bytes"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U8 idata chf_buf[2][24];				// synthesized CHs: [0] = CH00, [1] = CH chf_ch1
+U8	chf_ch1;							// CH in chf_buf[1]
+bit	chf_ok0;							// chf_buf[0] holds CH00
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+void chf_syn(U8 ch, U8 idata * dest);
+
+//-----------------------------------------------------------------------------
+// chf_chan() returns the synthesized regs of channel ch (from the cache if it is there).
+//	The CH00 copy is good until the next chf_flush(), any other until the next call.
+//-----------------------------------------------------------------------------
+//
+U8 idata * chf_chan(U8 ch){
+
+	if(ch == 0){
+		if(!chf_ok0){
+			chf_syn(0, chf_buf[0]);
+			chf_ok0 = 1;
+		}
+		return chf_buf[0];
+	}
+	if(ch != chf_ch1){
+		chf_syn(ch, chf_buf[1]);
+		chf_ch1 = ch;
+	}
+	return chf_buf[1];
+}
+
+//-----------------------------------------------------------------------------
+// chf_flush() empties the cache (call after a CH record is written or erased)
+//-----------------------------------------------------------------------------
+//
+void chf_flush(void){
+
+	chf_ok0 = 0;
+	chf_ch1 = CHF_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// chf_pack() converts the CH at src[24] to a record at rec[CH_REC].  returns 1 if the
+//	CH doesn't re-synthesize to src[] (can't be stored in this format).  Uses chf_buf[1].
+//-----------------------------------------------------------------------------
+//
+U8 chf_pack(U8 idata * src, U8 idata * rec){
+	U8	i;
+	U8	opt;
+	U32	f;
+
+	for(i=0; i<CH_REC; i++){
+		rec[i] = 0xff;
+	}
+	for(i=0; i<24; i++){
+		if(src[i] != 0xff) break;
+	}
+	if(i == 24) return 0;				// empty CH
+	f = syn_freq((U32 idata *)src);
+	opt = syn_opt((U32 idata *)src);
+	chf_ch1 = CHF_NONE;
+	if(syn_calc(f, SYN_SPC, opt, (U32 idata *)chf_buf[1]) != SYN_OK) return 1;
+	for(i=0; i<24; i++){
+		if(chf_buf[1][i] != src[i]) return 1;
+	}
+	rec[0] = (U8)(f >> 24);
+	rec[1] = (U8)(f >> 16);
+	rec[2] = (U8)(f >> 8);
+	rec[3] = (U8)f;
+	rec[4] = opt;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// chf_syn() synthesizes the regs of channel ch into dest[24] (all 0xff for an empty CH)
+//-----------------------------------------------------------------------------
+//
+void chf_syn(U8 ch, U8 idata * dest){
+	U8	i;
+	U32	f;
+	U8 code * rptr;
+
+	rptr = (U8 code *)CHAN_ADDR + (CH_REC * (U16)ch);
+	f = ((U32)rptr[0] << 24) | ((U32)rptr[1] << 16) | ((U16)rptr[2] << 8) | rptr[3];
+	if((f != 0xffffffffL) && (syn_calc(f, SYN_SPC, rptr[4], (U32 idata *)dest) == SYN_OK)){
+		return;
+	}
+	for(i=0; i<24; i++){
+		dest[i] = 0xff;
+	}
+}
+#endif
@@ -0,0 +1,25 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chfreq.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the frequency channel record format.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 idata * chf_chan(U8 ch);
+U8 chf_pack(U8 idata * src, U8 idata * rec);
+void chf_flush(void);
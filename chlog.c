@@ -0,0 +1,350 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chlog.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the log-structured channel store (CH_LOG = 1).  The
+ *             channel sectors hold an append-only log of channel records;
+ *             the newest record for a channel wins.  There is no RAM for an
+ *             index (256 B part), so chl_chan() scans the log from the newest
+ *             record back (at most LOG_NSECT * LOG_NREC slots, and only the
+ *             matching record is CRC checked).
+ *
+ *			   The sectors are used as a ring.  Records are appended to the head sector.  When
+ *			   it fills, the next (erased) sector becomes the head, and if the sector after that
+ *			   isn't erased (it is the tail), the tail's live records are copied to the new head
+ *			   and the tail is erased.  So there is always an erased sector ahead of the head, a
+ *			   CH re-write costs no erase until the log wraps, and the erases rotate thru all of
+ *			   the sectors.  Copies get a new seq# like any other record, so all of the records in
+ *			   the log are within the last 90 seq#s and an 8 bit seq# compare is good enough.  A
+ *			   copy that was interrupted by a power loss is harmless (same data, newer seq#).
+ *
+ *			   Sector: LOG_HDR byte header (LOG_MAGIC, sector seq#, ~seq#), then LOG_NREC records.
+ *			   Record: ch#, seq#, 24 reg bytes (as in the CH array), CRC16 (of the 26 bytes before it).
+ *				The ch# is written last, so a record with an erased ch# was never used.  A record
+ *				with all-erased reg bytes is a blank CH (see E16).
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Dropped the chl_idx[] RAM index (NUM_CHAN bytes of IDATA): chl_find() scans the log.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "flash.h"
+#include "channels.h"
+#include "crc.h"
+#include "chstore.h"
+#define CHLOG_INCL
+#include "chlog.h"
+
+#if (CH_LOG == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	LOG_NSECT	CHS_NSECT			// all of the CH sectors (from SECT00_ADDR)
+#define	LOG_HDR		8					// sector header size
+#define	LOG_REC		28					// record size
+#define	LOG_NREC	((SECTOR_SIZE - LOG_HDR) / LOG_REC)		// records per sector (18)
+#define	LOG_MAGIC	0xC5
+#define	LOG_NONE	0xFF				// chl_find(): no record
+
+#if (NUM_CHAN > ((LOG_NSECT - 2) * LOG_NREC))
+#error "CH_LOG: NUM_CHAN too large (the log must hold them in 3 sectors)"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U8	chl_head;							// head sector
+U8	chl_next;							// next free record in the head
+U8	chl_seq;							// next record seq#
+U8	chl_sseq;							// next sector seq#
+U8 code chl_blank[24] = {				// reg data for a CH w/o a record
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+U8 chl_find(U8 ch);
+U8 rec_ok(U8 code * rptr);
+U8 code * slot_addr(U8 g);
+U8 sect_fmtd(U8 s);
+U8 sect_blank(U8 s);
+void sect_open(U8 s);
+void chl_compact(U8 s);
+void rec_wr(U8 ch, U8 * src);
+
+//-----------------------------------------------------------------------------
+// chl_init() scans the log for the head and the next seq#s.  Unformatted sectors (e.g., the fixed
+//	CH array) are erased, and an interrupted compaction is finished.
+//	returns CHS_OK, CHS_CRCERR (bad record, skipped), or CHS_FMT (log was formatted, CHs lost)
+//-----------------------------------------------------------------------------
+//
+U8 chl_init(void){
+	U8	s;
+	U8	j;
+	U8	g;
+	U8	ch;
+	U8	rtn;
+	U8	b;
+	bit	have;			// a formatted sector/record has been seen
+	U8 code * rptr;
+
+	rtn = CHS_OK;
+	// check the sectors, find the head (newest sector seq#)
+	have = 0;
+	for(s=0; s<LOG_NSECT; s++){
+		if(sect_fmtd(s)){
+			rptr = (U8 code *)SECT00_ADDR + ((U16)s * SECTOR_SIZE);
+			if(!have || ((S8)(rptr[1] - chl_sseq) >= 0)){
+				chl_head = s;
+				chl_sseq = rptr[1];
+			}
+			have = 1;
+		}else{
+			if(!sect_blank(s)){
+				erase_flash((U8 xdata *)SECT00_ADDR + ((U16)s * SECTOR_SIZE));
+				rtn = CHS_FMT;				// not a log sector (or an interrupted erase)
+			}
+		}
+	}
+	if(!have){
+		chl_seq = 0;
+		chl_sseq = 0;
+		sect_open(0);						// new log
+		return rtn;
+	}
+	chl_sseq++;
+	// find the tail: walk back from the head while the sectors are formatted
+	s = chl_head;
+	for(j=1; j<LOG_NSECT; j++){
+		g = (s + LOG_NSECT - 1) % LOG_NSECT;
+		if(!sect_fmtd(g)) break;
+		s = g;
+	}
+	// check the records, tail to head
+	have = 0;
+	chl_next = 0;
+	do{
+		for(j=0; j<LOG_NREC; j++){
+			g = (s * LOG_NREC) + j;
+			rptr = slot_addr(g);
+			b = 0xff;
+			for(ch=0; ch<LOG_REC; ch++){
+				b &= rptr[ch];
+			}
+			if(b == 0xff) continue;			// unused
+			if(s == chl_head) chl_next = j + 1;
+			if(rptr[0] == 0xff) continue;	// interrupted append (ch# is written last)
+			if(!rec_ok(rptr)){
+				rtn = CHS_CRCERR;			// (chl_find() skips it)
+				continue;
+			}
+			if(!have || ((S8)(rptr[1] - chl_seq) >= 0)){
+				chl_seq = rptr[1];
+			}
+			have = 1;
+		}
+		if(s == chl_head) break;
+		s = (s + 1) % LOG_NSECT;
+	}while(1);
+	chl_seq++;
+	// an interrupted compaction leaves no erased sector ahead of the head
+	s = (chl_head + 1) % LOG_NSECT;
+	if(!sect_blank(s)) chl_compact(s);
+	return rtn;
+}
+
+//-----------------------------------------------------------------------------
+// chl_chan() returns a pointer to the reg data (24 bytes) of channel ch
+//-----------------------------------------------------------------------------
+//
+U8 code * chl_chan(U8 ch){
+	U8	g;
+
+	g = chl_find(ch);
+	if(g == LOG_NONE) return chl_blank;
+	return slot_addr(g) + 2;
+}
+
+//-----------------------------------------------------------------------------
+// chl_find() returns the slot# (sector * LOG_NREC + record) of channel ch's newest good record,
+//	or LOG_NONE.  The slots are searched from the head back to the tail (the sector after the
+//	head is always erased), so the 1st match is the newest.
+//-----------------------------------------------------------------------------
+//
+U8 chl_find(U8 ch){
+	U8	s;
+	U8	j;
+	U8	n;
+	U8	g;
+	U8 code * rptr;
+
+	s = chl_head;
+	n = chl_next;
+	for(j=0; j<LOG_NSECT; j++){
+		if(!sect_fmtd(s)) break;
+		while(n){
+			g = (s * LOG_NREC) + --n;
+			rptr = slot_addr(g);
+			if((rptr[0] == ch) && rec_ok(rptr)) return g;
+		}
+		s = (s + LOG_NSECT - 1) % LOG_NSECT;
+		n = LOG_NREC;
+	}
+	return LOG_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// rec_ok() returns 1 if the CRC of the record at rptr is good
+//-----------------------------------------------------------------------------
+//
+U8 rec_ok(U8 code * rptr){
+	U8	i;
+	U16	crc;
+
+	crc = 0;
+	for(i=0; i<LOG_REC; i++){
+		crc = calcrc(rptr[i], crc);			// CRC over the record and its CRC is 0
+	}
+	return (crc == 0);
+}
+
+//-----------------------------------------------------------------------------
+// chl_wr() appends a record for channel ch.  Opens the next sector (and compacts the tail)
+//	if the head is full.
+//-----------------------------------------------------------------------------
+//
+void chl_wr(U8 ch, U8 * src){
+	U8	s;
+
+	while(chl_next == LOG_NREC){
+		sect_open((chl_head + 1) % LOG_NSECT);
+		s = (chl_head + 1) % LOG_NSECT;
+		if(!sect_blank(s)) chl_compact(s);	// keep an erased sector ahead
+	}
+	rec_wr(ch, src);
+}
+
+//-----------------------------------------------------------------------------
+// rec_wr() writes a record to the next slot of the head (there must be room)
+//-----------------------------------------------------------------------------
+//
+void rec_wr(U8 ch, U8 * src){
+	U8	i;
+	U8	g;
+	U8	seq;
+	U16	crc;
+	U8 xdata * fptr;
+
+	seq = chl_seq++;
+	g = (chl_head * LOG_NREC) + chl_next++;
+	fptr = (U8 xdata *)slot_addr(g);
+	crc = calcrc(ch, 0);
+	crc = calcrc(seq, crc);
+	wr_flash(seq, fptr + 1);
+	for(i=0; i<24; i++){
+		crc = calcrc(src[i], crc);
+		wr_flash(src[i], fptr + 2 + i);
+	}
+	wr_flash((U8)(crc >> 8), fptr + 26);
+	wr_flash((U8)(crc & 0xff), fptr + 27);
+	wr_flash(ch, fptr);						// last: marks the record valid
+}
+
+//-----------------------------------------------------------------------------
+// chl_compact() copies the live records of sector s (the tail) to the head, then erases s.  The
+//	head is a newly opened sector (or was, when an interrupted compaction is finished), so they fit.
+//	A live record is the newest for its CH, and not blank (the tail has no older records to hide).
+//-----------------------------------------------------------------------------
+//
+void chl_compact(U8 s){
+	U8	j;
+	U8	g;
+	U8	i;
+	U8	b;
+	U8 code * rptr;
+
+	for(j=0; j<LOG_NREC; j++){
+		g = (s * LOG_NREC) + j;
+		rptr = slot_addr(g);
+		if((rptr[0] < NUM_CHAN) && (chl_find(rptr[0]) == g)){
+			b = 0xff;
+			for(i=2; i<26; i++){
+				b &= rptr[i];
+			}
+			if(b != 0xff) rec_wr(rptr[0], rptr + 2);
+		}
+	}
+	erase_flash((U8 xdata *)SECT00_ADDR + ((U16)s * SECTOR_SIZE));
+}
+
+//-----------------------------------------------------------------------------
+// slot_addr() returns the address of record slot g
+//-----------------------------------------------------------------------------
+//
+U8 code * slot_addr(U8 g){
+
+	return (U8 code *)SECT00_ADDR + ((U16)(g / LOG_NREC) * SECTOR_SIZE) + LOG_HDR + ((U16)(g % LOG_NREC) * LOG_REC);
+}
+
+//-----------------------------------------------------------------------------
+// sect_fmtd() returns 1 if sector s has a log header
+//-----------------------------------------------------------------------------
+//
+U8 sect_fmtd(U8 s){
+	U8 code * rptr;
+
+	rptr = (U8 code *)SECT00_ADDR + ((U16)s * SECTOR_SIZE);
+	return (rptr[0] == LOG_MAGIC) && (rptr[1] == (U8)~rptr[2]);
+}
+
+//-----------------------------------------------------------------------------
+// sect_blank() returns 1 if sector s is erased
+//-----------------------------------------------------------------------------
+//
+U8 sect_blank(U8 s){
+	U16	k;
+	U8 code * rptr;
+
+	rptr = (U8 code *)SECT00_ADDR + ((U16)s * SECTOR_SIZE);
+	for(k=0; k<SECTOR_SIZE; k++){
+		if(rptr[k] != 0xff) return 0;
+	}
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+// sect_open() makes (erased) sector s the head
+//-----------------------------------------------------------------------------
+//
+void sect_open(U8 s){
+	U8 xdata * fptr;
+
+	fptr = (U8 xdata *)SECT00_ADDR + ((U16)s * SECTOR_SIZE);
+	wr_flash(LOG_MAGIC, fptr++);
+	wr_flash(chl_sseq, fptr++);
+	wr_flash(~chl_sseq, fptr);
+	chl_sseq++;
+	chl_head = s;
+	chl_next = 0;
+}
+#endif
+
+//**************
+// End Of File
+//**************
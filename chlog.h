@@ -0,0 +1,25 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chlog.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the log-structured channel store.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 chl_init(void);
+U8 code * chl_chan(U8 ch);
+void chl_wr(U8 ch, U8 * src);
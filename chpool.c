@@ -0,0 +1,150 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chpool.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the pooled channel record format (CH_POOL = 1).  Most
+ *             channels share the same R2, R3, and R5 (and a few R4) values,
+ *             so a channel record holds R0 and R1, and a one byte index into
+ *             a pool of shared reg values for each of R2-R5 (CH_REC bytes vs 24).
+ *
+ *			   The records are an array at CHAN_ADDR, and the pool (POOL_NUM regs) follows
+ *			   the last record at POOL_ADDR.  Pool entries are appended to the first erased
+ *			   entry and never change, so a record can be written in place like a 24 byte CH.
+ *			   An index of 0xff (erased) is the reg value 0xffffffff, so an erased record is an
+ *			   empty CH.  A pool entry written by an interrupted CH write is left unused.
+ *			   chstore.c does the record writes/re-writes and keeps the table CRC16 over the
+ *			   expanded (24 byte) CHs, so the CH table looks the same to the host.
+ *
+ *			   The pool is only emptied by erasing all of the CH sectors ("EA").
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "flash.h"
+#include "channels.h"
+#include "chstore.h"
+#define CHPOOL_INCL
+#include "chpool.h"
+
+#if (CH_POOL == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	POOL_NONE	0xFF				// index of the erased reg value
+#define	POOL_FULL	0xFE				// chp_find(): no room in the pool
+
+#if (POOL_NUM > 254)
+#error "CH_POOL: POOL_NUM too large (8 bit index)"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U8 idata chp_buf[24];					// expanded CH (chp_chan())
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+U8 chp_find(U8 idata * src);
+
+//-----------------------------------------------------------------------------
+// chp_chan() expands the record of channel ch into chp_buf[].  returns chp_buf, which
+//	is good until the next call.
+//-----------------------------------------------------------------------------
+//
+U8 idata * chp_chan(U8 ch){
+	U8	i;
+	U8	j;
+	U8	k;
+	U8 code * rptr;
+	U8 code * pptr;
+
+	rptr = (U8 code *)CHAN_ADDR + (CH_REC * (U16)ch);
+	for(i=0; i<8; i++){
+		chp_buf[i] = rptr[i];			// R0, R1
+	}
+	for(j=8; j<CH_REC; j++){
+		k = rptr[j];					// R2-R5 index
+		if(k < POOL_NUM){
+			pptr = (U8 code *)POOL_ADDR + (4 * k);
+			chp_buf[i++] = pptr[0];
+			chp_buf[i++] = pptr[1];
+			chp_buf[i++] = pptr[2];
+			chp_buf[i++] = pptr[3];
+		}else{
+			chp_buf[i++] = 0xff;		// erased (or a bad index)
+			chp_buf[i++] = 0xff;
+			chp_buf[i++] = 0xff;
+			chp_buf[i++] = 0xff;
+		}
+	}
+	return chp_buf;
+}
+
+//-----------------------------------------------------------------------------
+// chp_pack() converts the CH at src[24] to a record at rec[CH_REC], adding any new
+//	R2-R5 values to the pool.  returns 1 if the pool is full.
+//-----------------------------------------------------------------------------
+//
+U8 chp_pack(U8 idata * src, U8 idata * rec){
+	U8	i;
+	U8	k;
+
+	for(i=0; i<8; i++){
+		rec[i] = src[i];				// R0, R1
+	}
+	for(; i<CH_REC; i++){
+		k = chp_find(src + 8 + ((i - 8) * 4));
+		if(k == POOL_FULL) return 1;
+		rec[i] = k;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// chp_find() returns the pool index of the reg value at src[4].  A new value is
+//	appended to the pool.  returns POOL_NONE for 0xffffffff, or POOL_FULL.
+//-----------------------------------------------------------------------------
+//
+U8 chp_find(U8 idata * src){
+	U8	k;
+	U8 code * pptr;
+	U8 xdata * fptr;
+
+	if((src[0] & src[1] & src[2] & src[3]) == 0xff) return POOL_NONE;
+	pptr = (U8 code *)POOL_ADDR;
+	for(k=0; k<POOL_NUM; k++){
+		if((pptr[0] == src[0]) && (pptr[1] == src[1]) && (pptr[2] == src[2]) && (pptr[3] == src[3])){
+			return k;
+		}
+		if((pptr[0] & pptr[1] & pptr[2] & pptr[3]) == 0xff){
+			fptr = (U8 xdata *)pptr;	// 1st erased entry: append
+			wr_flash(src[0], fptr++);
+			wr_flash(src[1], fptr++);
+			wr_flash(src[2], fptr++);
+			wr_flash(src[3], fptr);
+			if((pptr[0] != src[0]) || (pptr[1] != src[1]) || (pptr[2] != src[2]) || (pptr[3] != src[3])){
+				return POOL_FULL;		// didn't read back
+			}
+			return k;
+		}
+		pptr += 4;
+	}
+	return POOL_FULL;
+}
+#endif
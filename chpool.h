@@ -0,0 +1,24 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chpool.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the pooled channel record format.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 idata * chp_chan(U8 ch);
+U8 chp_pack(U8 idata * src, U8 idata * rec);
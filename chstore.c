@@ -0,0 +1,940 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chstore.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the channel store module.  All FLASH writes and erases
+ *             of the channel table go through here so that the table CRC16
+ *             (chs_crc) can be kept current without re-reading the table.
+ *             The CRC is saved in a record log in the gap below CHAN_ADDR and
+ *             checked against the table at boot.
+ *
+ *			   A programmed CH can only be changed by erasing its sector(s).  With CH_RWR, chs_wrchan()
+ *			   copies the sector to the scratch sector (with the new CH data in place), erases the sector,
+ *			   and copies it back.  A journal record (JRNL_ADDR) brackets the erase/copy so that boot can
+ *			   finish the job if power is lost.  Moving sector 0 leaves the CRC log and journal behind
+ *			   (they start over), which is also how a full journal is emptied.
+ *
+ *			   With CH_LOG, the channels are kept in a record log instead (chlog.c), and the
+ *			   table is the CH data that chs_chan() resolves.  There is no CRC log, re-write, or
+ *			   sector erase in that format.
+ *
+ *			   With CH_POOL, the CH records at CHAN_ADDR are CH_REC bytes (R2-R5 are pool indexes,
+ *			   chpool.c).  The records are written/re-written as above, and chs_chan() expands them.
+ *			   The CRC log and re-write work the same, but the table CRC16 is over the expanded CHs.
+ *			   CH_FREQ is the same w/ frequency records (chfreq.c) that chs_chan() synthesizes.
+ *
+ *			   CFG_CMD: the unit config (the ref ppm correction and reg overlays, pll.c) is a record log at
+ *			   CFG_ADDR, outside of the table.  A re-write of its sector carries the last record over
+ *			   (which is how a full log is emptied), and so does an erase of that sector (CH_RWR).
+ *
+ *			   chs_vmap[] (a bit per CH, set if R5 != 0xffffffff) and chs_vmax (highest valid CH)
+ *			   are kept with the table so that the port logic doesn't have to scan FLASH.
+ *
+ *			   Because the XMODEM CRC is linear (no init or final xor), a change to
+ *			   bytes [a, b) of the table changes the CRC by CRC(old ^ new over [a, b))
+ *			   shifted through the (len - b) bytes that follow (crc_shift()).
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Added chs_sectoff() for the sector CRC query.
+ *						Added chs_wrchan() and the CH re-write (CH_RWR).
+ *						Added chs_chan() and the log-structured store option (CH_LOG).
+ *						Added the valid CH bitmap, chs_valid(), and chs_maxvalid().
+ *						Sector counts come from NUM_SECT (channels.h), with compile-time checks on the layout.
+ *						Added the pooled CH format (CH_POOL).
+ *						Added the frequency CH format (CH_FREQ).  scr_restore() copies sector 0's gap last.
+ *						Added the unit config log (reference ppm correction).
+ *						The config log holds the pll.c config image (ppm and reg overlays): chs_loadcfg()
+ *							and chs_savecfg() replace chs_ppm() and chs_setppm().
+ *						The config log Fns are only built if CFG_CMD = 1.
+ *						sect_move() never writes the lock byte (the scratch sector's last byte).  The moved
+ *							sector's last byte is kept in the journal record (JRNL_TAG, last, sect, done).
+ *						A full CRC log is emptied by moving sector 0 (CH_RWR), so the boot check stays on.
+ *						chs_valid() is bounded to NUM_CHAN (poll_port() checks any BCD CH# with it).
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "flash.h"
+#include "channels.h"
+#include "crc.h"
+#define CHSTORE_INCL
+#include "chstore.h"
+#include "chlog.h"
+#include "chpool.h"
+#include "chfreq.h"
+#include "pll.h"
+
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	CHS_LEN		(24 * NUM_CHAN)			// channel table size
+
+// layout checks
+#if ((SECT00_ADDR % SECTOR_SIZE) != 0) || ((SCRATCH_ADDR % SECTOR_SIZE) != 0)
+#error "SECT00_ADDR and SCRATCH_ADDR must be on a sector boundary"
+#endif
+#if (CHAN_ADDR < SECT00_ADDR) || ((CHAN_ADDR - SECT00_ADDR) >= SECTOR_SIZE)
+#error "CHAN_ADDR must be in sector 0"
+#endif
+#if (CRCLOG_ADDR < SECT00_ADDR) || ((CRCLOG_ADDR + CRCLOG_LEN) > JRNL_ADDR) || ((JRNL_ADDR + JRNL_LEN) > CHAN_ADDR)
+#error "the CRC log and journal must fit in the gap below CHAN_ADDR"
+#endif
+#if ((CH_LOG + CH_POOL + CH_FREQ) > 1)
+#error "only one of CH_LOG, CH_POOL, and CH_FREQ can be used"
+#endif
+#if (CH_LOG == 0) && (NUM_SECT > CHS_NSECT)
+#error "NUM_CHAN is too large for the CH sectors"
+#endif
+#if (CH_LOG == 0) && ((POOL_ADDR + (4 * POOL_NUM)) > CFG_ADDR)
+#error "NUM_CHAN is too large for the CH sectors (config log)"
+#endif
+#if (CHS_LEN >= 4096)
+#error "NUM_CHAN is too large for crc_shift()"
+#endif
+#if CHS_FLAT && (((CHAN_ADDR - SECT00_ADDR + (24 * 16)) % SECTOR_SIZE) != 0)
+#error "E16 (main.c) needs CH16 to start a sector"
+#endif
+// CRC log: 4 byte records (CRC16, ~CRC16), 1st erased record ends the log.  The log is cleared
+//	when sector 0 is erased or moved.  A full log is emptied by moving sector 0 (CH_RWR), else the
+//	last slot is reserved for the "stale" record (0x00000000), written when the log is full.
+#define	CRCLOG_REC	4
+#define	CRCLOG_NUM	(CRCLOG_LEN / CRCLOG_REC)
+// re-write journal: 4 byte records (JRNL_TAG, last, sect, done), done = 0 when the sector is
+//	copied back.  A record with done = 0xff is an interrupted re-write.  The scratch sector's last
+//	byte is the lock byte (LOCK_ADDR), so the moved sector's last byte is kept in the record (last)
+//	instead.  sect is written after last, so a record w/o a valid sect# was never started.
+#define	JRNL_REC	4
+#define	JRNL_NUM	(JRNL_LEN / JRNL_REC)
+#define	JRNL_TAG	0x5A
+#define	JRNL_NONE	0xFF
+#define	GAP_LEN		(CHAN_ADDR - SECT00_ADDR)
+#define	SCR_JRNL	(SCRATCH_ADDR + (JRNL_ADDR - SECT00_ADDR))	// journal in a scratch copy of sector 0
+#define	SCR_LAST	(SECTOR_SIZE - 1)		// sector offset that isn't staged (LOCK_ADDR in the scratch sector)
+// config log: CFG_REC byte records (config image, CRC16), the last good record is the config.
+//	1st erased record ends the log.
+#define	CFG_REC		(CFG_DLEN + 2)
+#define	CFG_NUM		(CFG_LEN / CFG_REC)
+#define	CFG_OFF		((CFG_ADDR - SECT00_ADDR) % SECTOR_SIZE)	// offset of the log in its sector
+#if (CFG_NUM == 0)
+#error "CFG_LEN is too small for the config image (OVL_NUM)"
+#endif
+// nothing may write the lock byte: sect_move() doesn't stage a sector's last byte, and the
+//	config log (and its scratch copy) must end before the last byte of its sector
+#if ((SCRATCH_ADDR + SECTOR_SIZE - 1) > LOCK_ADDR) || ((SECT00_ADDR + (CHS_NSECT * SECTOR_SIZE)) > SCRATCH_ADDR)
+#error "the CH and scratch sectors must end at or below LOCK_ADDR"
+#endif
+#if ((CFG_OFF + (CFG_NUM * CFG_REC)) > (SECTOR_SIZE - 1)) || ((CFG_ADDR + (CFG_NUM * CFG_REC)) > LOCK_ADDR)
+#error "the config log must end before the last byte of its sector (LOCK_ADDR)"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U16	chs_tcrc;						// channel table CRC16
+U16	chs_dcrc;						// CRC16 of the changes to the channel being written
+U16	chs_off;						// table offset of the next byte to write
+bit	chs_held;						// don't save the CRC (see chs_hold())
+bit	chs_dirty;						// chs_tcrc not saved
+U8 idata chs_vmap[(NUM_CHAN + 7) / 8];	// valid CH bitmap
+U8	chs_vmax;						// highest valid CH (0 if none)
+U8 code vmap_bit[8] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+#if (CH_LOG == 0) && (CH_RWR == 1)
+U8 idata * chs_src;					// new CH data for the re-write
+bit	chs_sub;						// sect_move(): substitute chs_src at chs_off
+#if (CFG_CMD == 1)
+U8 idata * chs_cfgsrc;				// sect_move(): new config record for CFG_SECT (0 = keep the last)
+bit	chs_blank;						// sect_move(): CFG_SECT w/o the CH data (erase, keeping the config)
+#endif
+#endif
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+void vmap_build(void);
+void vmap_set(U8 chnum);
+void sect_erase(U8 sect);
+#if (CFG_CMD == 1)
+U8 cfg_find(void);
+U8 code * cfg_last(void);
+void cfg_wr(U8 xdata * fptr, U8 idata * img);
+#endif
+#if (CH_LOG == 0)
+U8 crclog_find(void);
+void crclog_save(void);
+#endif
+#if (CH_LOG == 0) && (CH_RWR == 1)
+U8 jrnl_find(U8 code * jptr);
+U8 jrnl_pend(U8 code * jptr);
+void sect_move(U8 sect);
+void scr_restore(U8 sect);
+U8 chs_recover(void);
+#endif
+
+//-----------------------------------------------------------------------------
+// chs_init() calculates the table CRC and checks it against the CRC log.
+//	returns CHS_OK, CHS_CRCERR (table doesn't match), or CHS_NOLOG (log is full, CH_RWR = 0).
+//	CH_LOG: scans the log.  returns CHS_OK, CHS_CRCERR (bad record), or CHS_FMT.
+//-----------------------------------------------------------------------------
+//
+U8 chs_init(void){
+	U8	i;
+#if (CH_LOG == 0)
+	U8	j;
+	U8 code * rptr;
+#endif
+
+	chs_held = 0;
+	chs_dirty = 0;
+#if (CH_FREQ == 1)
+	chf_flush();
+#endif
+#if (CH_LOG == 1)
+	i = chl_init();
+	vmap_build();
+	chs_tcrc = chs_crcrange(0, CHS_LEN);
+	return i;
+#else
+	j = CHS_OK;
+#if (CH_RWR == 1)
+#if (CFG_CMD == 1)
+	chs_cfgsrc = 0;
+	chs_blank = 0;
+#endif
+	if(chs_recover()) j = CHS_RECOV;
+#endif
+	vmap_build();
+	chs_tcrc = chs_crcrange(0, CHS_LEN);
+	i = crclog_find();
+	if(i == 0){
+		crclog_save();						// 1st boot w/ the log, start it
+		return j;
+	}
+	rptr = (U8 code *)(CRCLOG_ADDR + ((i - 1) * CRCLOG_REC));
+	if((rptr[0] == 0) && (rptr[2] == 0)){
+		return (j == CHS_OK) ? CHS_NOLOG : j;	// stale, can't check
+	}
+	if((rptr[0] != (U8)(chs_tcrc >> 8)) || (rptr[1] != (U8)(chs_tcrc & 0xff))){
+		return CHS_CRCERR;
+	}
+	return j;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// chs_crc() returns the table CRC16
+//-----------------------------------------------------------------------------
+//
+U16 chs_crc(void){
+
+	return chs_tcrc;
+}
+
+//-----------------------------------------------------------------------------
+// chs_chan() returns a pointer to the reg data (24 bytes) of channel chnum
+//	(CH_POOL/CH_FREQ: an expanded copy, good until the next call)
+//-----------------------------------------------------------------------------
+//
+U8 CHS_MEM * chs_chan(U8 chnum){
+
+#if (CH_LOG == 1)
+	return chl_chan(chnum);
+#elif (CH_POOL == 1)
+	return chp_chan(chnum);
+#elif (CH_FREQ == 1)
+	return chf_chan(chnum);
+#else
+	return (U8 code *)CHAN_ADDR + (24 * (U16)chnum);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// chs_crcrange() calculates the CRC16 of len bytes at table offset off
+//-----------------------------------------------------------------------------
+//
+U16 chs_crcrange(U16 off, U16 len){
+	U16	crc;
+	U8	i;
+	U8	n;
+	U8 CHS_MEM * rptr;
+
+	crc = 0;
+	while(len){
+		i = off % 24;
+		rptr = chs_chan(off / 24) + i;
+		n = 24 - i;							// to the end of the CH
+		if(n > len) n = len;
+		off += n;
+		len -= n;
+		while(n--){
+			crc = calcrc(*rptr++, crc);
+		}
+	}
+	return crc;
+}
+
+#if CHS_FLAT
+//-----------------------------------------------------------------------------
+// chs_sectoff() returns the table offset of the start of sector# sect (0 = SECT00_ADDR),
+//	limited to the table.  Sector sect holds table bytes [chs_sectoff(sect), chs_sectoff(sect+1)).
+//-----------------------------------------------------------------------------
+//
+U16 chs_sectoff(U8 sect){
+	U16	a;
+
+	a = (U16)sect * SECTOR_SIZE;			// sector start, relative to SECT00_ADDR
+	if(a < (CHAN_ADDR - SECT00_ADDR)) return 0;
+	a -= (CHAN_ADDR - SECT00_ADDR);
+	if(a > CHS_LEN) a = CHS_LEN;
+	return a;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// chs_recalc() re-calculates the table CRC16 (use after writing FLASH directly)
+//-----------------------------------------------------------------------------
+//
+void chs_recalc(void){
+
+	vmap_build();
+	chs_tcrc = chs_crcrange(0, CHS_LEN);
+#if (CH_LOG == 0)
+	crclog_save();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// chs_hold() holds off (on != 0) saving the CRC during a multi-CH update.  The CRC
+//	is saved when the hold is released.
+//-----------------------------------------------------------------------------
+//
+void chs_hold(U8 on){
+
+	chs_held = (on != 0);
+#if (CH_LOG == 0)
+	if(!chs_held && chs_dirty){
+		crclog_save();
+	}
+#endif
+}
+
+#if CHS_FLAT
+
+//-----------------------------------------------------------------------------
+// chs_wrbegin() starts writing channel chnum.  Follow with 24 chs_wrbyte(), then chs_wrend().
+//-----------------------------------------------------------------------------
+//
+void chs_wrbegin(U8 chnum){
+
+	chs_off = 24 * (U16)chnum;
+	chs_dcrc = 0;
+}
+
+//-----------------------------------------------------------------------------
+// chs_wrbyte() writes the next byte of the channel.  returns 1 if the FLASH doesn't
+//	read back (the byte wasn't erased)
+//-----------------------------------------------------------------------------
+//
+U8 chs_wrbyte(U8 c){
+	U8	d;
+	U8 code * rptr;
+
+	rptr = (U8 code *)(CHAN_ADDR + chs_off);
+	d = *rptr;								// old
+	wr_flash(c, (U8 xdata *)(CHAN_ADDR + chs_off));
+	chs_off++;
+	d ^= *rptr;								// old ^ new
+	chs_dcrc = calcrc(d, chs_dcrc);
+	return (*rptr != c);
+}
+
+//-----------------------------------------------------------------------------
+// chs_wrend() ends the channel write, and updates the table CRC16
+//-----------------------------------------------------------------------------
+//
+void chs_wrend(void){
+
+	chs_tcrc ^= crc_shift(chs_dcrc, CHS_LEN - chs_off);
+	crclog_save();
+}
+
+//-----------------------------------------------------------------------------
+// chs_erase() erases sector# sect (0 = SECT00_ADDR), and updates the table CRC16
+//-----------------------------------------------------------------------------
+//
+void chs_erase(U8 sect){
+	U16	a;				// table offset of the 1st CH byte in the sector
+	U16	b;				// ..and of the end
+	U16	crc;
+	U8 code * rptr;
+
+	a = chs_sectoff(sect);
+	b = chs_sectoff(sect + 1);
+	crc = 0;
+	for(rptr=(U8 code *)(CHAN_ADDR + a); rptr<(U8 code *)(CHAN_ADDR + b); rptr++){
+		crc = calcrc(~(*rptr), crc);		// old ^ 0xff
+	}
+	sect_erase(sect);
+	vmap_build();
+	chs_tcrc ^= crc_shift(crc, CHS_LEN - b);
+	crclog_save();							// (sector 0 erase clears the log)
+}
+#else
+//-----------------------------------------------------------------------------
+// chs_erase() erases sector# sect (CH_LOG: the log is lost, CH_POOL/CH_FREQ: call
+//	chs_init() after the last one)
+//-----------------------------------------------------------------------------
+//
+void chs_erase(U8 sect){
+
+	sect_erase(sect);
+#if (CH_FREQ == 1)
+	chf_flush();
+#endif
+	vmap_build();
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// sect_erase() erases sector# sect.  CFG_CMD: CFG_SECT is re-written w/o the CH data instead,
+//	so that the config is kept (CH_RWR = 0: the config is lost).
+//-----------------------------------------------------------------------------
+//
+void sect_erase(U8 sect){
+
+#if (CH_LOG == 0) && (CH_RWR == 1) && (CFG_CMD == 1)
+	if(sect == CFG_SECT){
+		if(jrnl_find((U8 code *)JRNL_ADDR) == JRNL_NUM){
+			chs_sub = 0;
+			sect_move(0);							// journal full: empty it
+		}
+		chs_sub = 0;
+		chs_blank = 1;
+		sect_move(sect);
+		chs_blank = 0;
+		return;
+	}
+#endif
+	erase_flash((U8 xdata *)SECT00_ADDR + ((U16)sect * SECTOR_SIZE));
+}
+
+//-----------------------------------------------------------------------------
+// chs_wrchan() programs channel chnum from src[24].  The CH is written in place if the new
+//	data only clears bits, else (CH_RWR) its sector(s) are re-written.  CH_LOG: a record is
+//	appended.  CH_POOL/CH_FREQ: the CH's record is written the same way.  returns 1 if the
+//	FLASH doesn't read back (or the CH_POOL pool is full, or CH_FREQ can't store the CH).
+//-----------------------------------------------------------------------------
+//
+U8 chs_wrchan(U8 chnum, U8 idata * src){
+	U8	i;
+	U8	c;
+	U8	s;
+	U8 CHS_MEM * rptr;
+#if (CH_LOG == 1) || CHS_PACK || (CH_RWR == 1)
+	U16	crc;
+#endif
+#if CHS_PACK
+	U8 idata rec[CH_REC];				// new CH record
+	U8 code * pptr;
+#endif
+
+	rptr = chs_chan(chnum);
+	c = 0;
+	s = 0;
+	for(i=0; i<24; i++){
+		if(rptr[i] != src[i]) s = 1;
+		if((rptr[i] & src[i]) != src[i]) c = 1;		// needs a 0 -> 1
+	}
+	if(!s) return 0;								// no change
+#if (CH_LOG == 1)
+	crc = 0;
+	for(i=0; i<24; i++){
+		crc = calcrc(rptr[i] ^ src[i], crc);
+	}
+	chl_wr(chnum, src);
+	chs_tcrc ^= crc_shift(crc, CHS_LEN - (24 * (U16)chnum + 24));
+#else
+#if CHS_PACK
+	crc = 0;
+	for(i=0; i<24; i++){
+		crc = calcrc(rptr[i] ^ src[i], crc);
+	}
+#if (CH_POOL == 1)
+	if(chp_pack(src, rec)) return 1;				// pool full
+#else
+	if(chf_pack(src, rec)) return 1;				// not a synthesized CH
+#endif
+	pptr = (U8 code *)CHAN_ADDR + (CH_REC * (U16)chnum);
+	c = 0;
+	for(i=0; i<CH_REC; i++){
+		if((pptr[i] & rec[i]) != rec[i]) c = 1;		// needs a 0 -> 1
+	}
+#endif
+#if (CH_RWR == 1)
+	if(c){
+		chs_off = CH_REC * (U16)chnum;
+#if CHS_PACK
+		chs_src = rec;
+#else
+		chs_src = src;
+		crc = 0;
+		for(i=0; i<24; i++){
+			crc = calcrc(rptr[i] ^ src[i], crc);
+		}
+#endif
+		// the CH is in 1 or 2 sectors
+		for(s=(chs_off + GAP_LEN) / SECTOR_SIZE; s<=(chs_off + (CH_REC - 1) + GAP_LEN) / SECTOR_SIZE; s++){
+			if((s != 0) && (jrnl_find((U8 code *)JRNL_ADDR) == JRNL_NUM)){
+				chs_sub = 0;
+				sect_move(0);						// journal full: empty it
+			}
+			chs_sub = 1;
+			sect_move(s);
+		}
+		chs_tcrc ^= crc_shift(crc, CHS_LEN - (24 * (U16)chnum + 24));
+		crclog_save();
+	}else
+#endif
+	{
+#if CHS_PACK
+		for(i=0; i<CH_REC; i++){
+			if(pptr[i] != rec[i]) wr_flash(rec[i], (U8 xdata *)pptr + i);
+		}
+		chs_tcrc ^= crc_shift(crc, CHS_LEN - (24 * (U16)chnum + 24));
+		crclog_save();
+#else
+		chs_wrbegin(chnum);
+		for(i=0; i<24; i++){
+			chs_wrbyte(src[i]);
+		}
+		chs_wrend();
+#endif
+	}
+#endif
+#if (CH_FREQ == 1)
+	chf_flush();									// re-synthesize from the new record
+#endif
+	vmap_set(chnum);
+	rptr = chs_chan(chnum);
+	c = 0;
+	for(i=0; i<24; i++){
+		if(rptr[i] != src[i]) c = 1;
+	}
+	return c;
+}
+
+//-----------------------------------------------------------------------------
+// chs_valid() returns non-zero if channel chnum is valid (R5 != 0xffffffff).  A chnum past the
+//	table (e.g., a BCD input > NUM_CHAN - 1) is not valid.
+//-----------------------------------------------------------------------------
+//
+U8 chs_valid(U8 chnum){
+
+	if(chnum >= NUM_CHAN) return 0;
+	return chs_vmap[chnum >> 3] & vmap_bit[chnum & 0x07];
+}
+
+//-----------------------------------------------------------------------------
+// chs_maxvalid() returns the highest valid channel (0 if there are none)
+//-----------------------------------------------------------------------------
+//
+U8 chs_maxvalid(void){
+
+	return chs_vmax;
+}
+
+//-----------------------------------------------------------------------------
+// vmap_build() builds the valid CH bitmap from the table
+//-----------------------------------------------------------------------------
+//
+void vmap_build(void){
+	U8	i;
+
+	for(i=0; i<sizeof(chs_vmap); i++){
+		chs_vmap[i] = 0;
+	}
+	chs_vmax = 0;
+	for(i=0; i<NUM_CHAN; i++){
+		vmap_set(i);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// vmap_set() updates the bitmap (and chs_vmax) for channel chnum
+//-----------------------------------------------------------------------------
+//
+void vmap_set(U8 chnum){
+	U8 CHS_MEM * rptr;
+
+	rptr = chs_chan(chnum) + 20;			// R5
+	if((rptr[0] & rptr[1] & rptr[2] & rptr[3]) != 0xff){
+		chs_vmap[chnum >> 3] |= vmap_bit[chnum & 0x07];
+		if(chnum > chs_vmax) chs_vmax = chnum;
+	}else{
+		chs_vmap[chnum >> 3] &= ~vmap_bit[chnum & 0x07];
+		if(chnum == chs_vmax){
+			while(chs_vmax != 0){
+				if(chs_valid(--chs_vmax)) break;
+			}
+		}
+	}
+}
+
+#if (CH_LOG == 0) && (CH_RWR == 1)
+//-----------------------------------------------------------------------------
+// jrnl_find() returns the # of records in the journal at jptr
+//-----------------------------------------------------------------------------
+//
+U8 jrnl_find(U8 code * jptr){
+	U8	i;
+
+	for(i=0; i<JRNL_NUM; i++){
+		if(jptr[0] == 0xff) break;
+		jptr += JRNL_REC;
+	}
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// jrnl_pend() returns the sector# of an interrupted re-write in the journal at jptr, or JRNL_NONE
+//-----------------------------------------------------------------------------
+//
+U8 jrnl_pend(U8 code * jptr){
+	U8	i;
+
+	i = jrnl_find(jptr);
+	if(i == 0) return JRNL_NONE;
+	jptr += (i - 1) * JRNL_REC;
+	// (a CFG_SECT re-write can be past NUM_SECT)
+	if((jptr[0] == JRNL_TAG) && (jptr[3] == 0xff) && (jptr[2] < CHS_NSECT)){
+		return jptr[2];
+	}
+	return JRNL_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// sect_move() re-writes sector# sect through the scratch sector.  If chs_sub, the CH record at
+//	chs_off is replaced by chs_src[].  Sector 0 is moved without the CRC log/journal (gap), and
+//	(CFG_CMD) CFG_SECT w/ only the last config record (or chs_cfgsrc[]), and w/o the CH data if chs_blank.
+//	The sector's last byte goes in the journal record, not the scratch sector (LOCK_ADDR).
+//-----------------------------------------------------------------------------
+//
+void sect_move(U8 sect){
+	U16	k;
+	U16	a;
+	U8	c;
+	U8	j;
+	U8	e;				// the sector's last byte
+	U8 code * sptr;
+	U8 xdata * fptr;
+
+	sptr = (U8 code *)SECT00_ADDR + ((U16)sect * SECTOR_SIZE);
+	fptr = (U8 xdata *)SCRATCH_ADDR;
+	erase_flash(fptr);
+	a = (U16)sptr - CHAN_ADDR;				// table offset of the sector start (for k >= GAP_LEN if sect 0)
+	e = 0xff;
+	for(k=((sect == 0) ? GAP_LEN : 0); k<SECTOR_SIZE; k++){
+#if (CFG_CMD == 1)
+		if((sect == CFG_SECT) && (chs_blank || (k >= CFG_OFF))) break;
+#endif
+		c = sptr[k];
+		if(chs_sub && ((U16)(a + k - chs_off) < CH_REC)){
+			c = chs_src[(U16)(a + k - chs_off)];
+		}
+		if(k == SCR_LAST) e = c;
+		else if(c != 0xff) wr_flash(c, fptr + k);
+	}
+#if (CFG_CMD == 1)
+	if(sect == CFG_SECT){
+		if(chs_cfgsrc){
+			cfg_wr(fptr + CFG_OFF, chs_cfgsrc);
+		}else{
+			sptr = cfg_last();
+			if(sptr){
+				for(k=0; k<CFG_REC; k++){
+					wr_flash(sptr[k], fptr + CFG_OFF + k);
+				}
+			}
+		}
+	}
+#endif
+	// journal: start the record
+	if(sect == 0){
+		j = 0;
+		fptr = (U8 xdata *)SCR_JRNL;		// the moved sector 0 starts a new journal
+	}else{
+		j = jrnl_find((U8 code *)JRNL_ADDR);
+		fptr = (U8 xdata *)JRNL_ADDR + (j * JRNL_REC);
+	}
+	wr_flash(JRNL_TAG, fptr++);
+	wr_flash(e, fptr++);
+	wr_flash(sect, fptr);
+	scr_restore(sect);
+}
+
+//-----------------------------------------------------------------------------
+// scr_restore() erases sector# sect, copies the scratch sector to it, and closes the journal record.
+//	Sector 0's gap (the new journal) is copied last: chs_recover() finds an interrupted sector 0
+//	copy by the erased gap.  The sector's last byte comes from the journal record.
+//-----------------------------------------------------------------------------
+//
+void scr_restore(U8 sect){
+	U16	k;
+	U16	a;
+	U8	c;
+	U8 code * rptr;
+	U8 code * jptr;
+	U8 xdata * fptr;
+
+	if(sect == 0){
+		jptr = (U8 code *)SCR_JRNL;
+	}else{
+		jptr = (U8 code *)JRNL_ADDR + ((jrnl_find((U8 code *)JRNL_ADDR) - 1) * JRNL_REC);
+	}
+	fptr = (U8 xdata *)SECT00_ADDR + ((U16)sect * SECTOR_SIZE);
+	erase_flash(fptr);
+	rptr = (U8 code *)SCRATCH_ADDR;
+	for(k=0; k<SECTOR_SIZE; k++){
+		a = (sect == 0) ? ((k + GAP_LEN) % SECTOR_SIZE) : k;
+		c = (a == SCR_LAST) ? jptr[1] : rptr[a];
+		if(c != 0xff) wr_flash(c, fptr + a);
+	}
+	if(sect == 0){
+		wr_flash(0, (U8 xdata *)JRNL_ADDR + 3);		// (the copied journal)
+	}
+	wr_flash(0, (U8 xdata *)jptr + 3);				// sector 0: so a later sector 0 erase can't revive it
+}
+
+//-----------------------------------------------------------------------------
+// chs_recover() finishes an interrupted re-write.  returns 1 if a sector was recovered.
+//	If power was lost after sector 0 was erased, the journal is in the scratch sector.
+//-----------------------------------------------------------------------------
+//
+U8 chs_recover(void){
+	U8	s;
+	U8	i;
+	U8 code * rptr;
+
+	s = jrnl_pend((U8 code *)JRNL_ADDR);
+	if(s == JRNL_NONE){
+		rptr = (U8 code *)SECT00_ADDR;
+		for(i=0; i<GAP_LEN; i++){
+			if(rptr[i] != 0xff) return 0;
+		}
+		if(jrnl_pend((U8 code *)SCR_JRNL) != 0) return 0;	// gap erased: look for a sector 0 move
+		s = 0;
+	}
+	scr_restore(s);
+	return 1;
+}
+#endif
+
+#if (CH_LOG == 0)
+//-----------------------------------------------------------------------------
+// crclog_find() returns the # of records in the CRC log
+//-----------------------------------------------------------------------------
+//
+U8 crclog_find(void){
+	U8	i;
+	U8 code * rptr;
+
+	rptr = (U8 code *)CRCLOG_ADDR;
+	for(i=0; i<CRCLOG_NUM; i++){
+		if((rptr[0] & rptr[1] & rptr[2] & rptr[3]) == 0xff) break;
+		rptr += CRCLOG_REC;
+	}
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// crclog_save() appends chs_tcrc to the CRC log.  If the log is full, sector 0 is moved to empty
+//	it (CH_RWR), else the stale record is written.
+//-----------------------------------------------------------------------------
+//
+void crclog_save(void){
+	U8	i;
+#if (CH_RWR == 0)
+	U8	j;
+#endif
+	U8 xdata * fptr;
+	U8 code * rptr;
+
+	if(chs_held){
+		chs_dirty = 1;
+		return;
+	}
+	chs_dirty = 0;
+	i = crclog_find();
+	if(i != 0){
+		rptr = (U8 code *)(CRCLOG_ADDR + ((i - 1) * CRCLOG_REC));
+		if((rptr[0] == (U8)(chs_tcrc >> 8)) && (rptr[1] == (U8)(chs_tcrc & 0xff)) && (rptr[2] != 0)){
+			return;							// no change
+		}
+	}
+#if (CH_RWR == 1)
+	if(i == CRCLOG_NUM){
+		chs_sub = 0;
+		sect_move(0);						// log full: empty it (and the journal)
+		i = 0;
+	}
+#else
+	if(i == CRCLOG_NUM) return;				// stale
+#endif
+	fptr = (U8 xdata *)(CRCLOG_ADDR + (i * CRCLOG_REC));
+#if (CH_RWR == 0)
+	if(i == (CRCLOG_NUM - 1)){
+		for(j=0; j<CRCLOG_REC; j++){
+			wr_flash(0, fptr++);			// log full, mark stale
+		}
+		return;
+	}
+#endif
+	wr_flash((U8)(chs_tcrc >> 8), fptr++);
+	wr_flash((U8)(chs_tcrc & 0xff), fptr++);
+	wr_flash(~(U8)(chs_tcrc >> 8), fptr++);
+	wr_flash(~(U8)(chs_tcrc & 0xff), fptr);
+}
+#endif
+
+#if (CFG_CMD == 1)
+//-----------------------------------------------------------------------------
+// chs_loadcfg() copies the saved config image (CFG_DLEN bytes) to img[].  returns 1 (img[]
+//	not changed) if there is none.
+//-----------------------------------------------------------------------------
+//
+U8 chs_loadcfg(U8 idata * img){
+	U8	i;
+	U8 code * rptr;
+
+	rptr = cfg_last();
+	if(rptr == 0) return 1;
+	for(i=0; i<CFG_DLEN; i++){
+		img[i] = rptr[i];
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// chs_savecfg() saves the config image at img[].  A full config log is emptied by re-writing
+//	its sector (CH_LOG: erasing the scratch sector).  returns 1 if the record doesn't read back
+//	(or the log is full and CH_RWR = 0: erase the last CH sector).
+//-----------------------------------------------------------------------------
+//
+U8 chs_savecfg(U8 idata * img){
+	U8	i;
+	U8 code * rptr;
+
+	rptr = cfg_last();
+	if(rptr){
+		for(i=0; i<CFG_DLEN; i++){
+			if(rptr[i] != img[i]) break;
+		}
+		if(i == CFG_DLEN) return 0;			// no change
+	}
+	i = cfg_find();
+	if(i == CFG_NUM){
+#if (CH_LOG == 1)
+		erase_flash((U8 xdata *)CFG_ADDR);
+		cfg_wr((U8 xdata *)CFG_ADDR, img);
+#elif (CH_RWR == 1)
+		if(jrnl_find((U8 code *)JRNL_ADDR) == JRNL_NUM){
+			chs_sub = 0;
+			sect_move(0);							// journal full: empty it
+		}
+		chs_sub = 0;
+		chs_cfgsrc = img;
+		sect_move(CFG_SECT);
+		chs_cfgsrc = 0;
+#else
+		return 1;
+#endif
+	}else{
+		cfg_wr((U8 xdata *)CFG_ADDR + (i * CFG_REC), img);
+	}
+	rptr = cfg_last();
+	if(rptr == 0) return 1;
+	for(i=0; i<CFG_DLEN; i++){
+		if(rptr[i] != img[i]) return 1;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// cfg_find() returns the # of records in the config log
+//-----------------------------------------------------------------------------
+//
+U8 cfg_find(void){
+	U8	i;
+	U8	j;
+	U8 code * rptr;
+
+	rptr = (U8 code *)CFG_ADDR;
+	for(i=0; i<CFG_NUM; i++){
+		for(j=0; j<CFG_REC; j++){
+			if(rptr[j] != 0xff) break;
+		}
+		if(j == CFG_REC) break;				// erased
+		rptr += CFG_REC;
+	}
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// cfg_last() returns a pointer to the last good config record, or 0 if there is none
+//-----------------------------------------------------------------------------
+//
+U8 code * cfg_last(void){
+	U8	i;
+	U8	j;
+	U16	crc;
+	U8 code * rptr;
+	U8 code * gptr;
+
+	gptr = 0;
+	rptr = (U8 code *)CFG_ADDR;
+	for(i=cfg_find(); i!=0; i--){
+		crc = 0;
+		for(j=0; j<CFG_DLEN; j++){
+			crc = calcrc(rptr[j], crc);
+		}
+		if((rptr[CFG_DLEN] == (U8)(crc >> 8)) && (rptr[CFG_DLEN + 1] == (U8)crc)){
+			gptr = rptr;
+		}
+		rptr += CFG_REC;
+	}
+	return gptr;
+}
+
+//-----------------------------------------------------------------------------
+// cfg_wr() writes a config record of the image at img[] to fptr
+//-----------------------------------------------------------------------------
+//
+void cfg_wr(U8 xdata * fptr, U8 idata * img){
+	U8	i;
+	U16	crc;
+
+	crc = 0;
+	for(i=0; i<CFG_DLEN; i++){
+		crc = calcrc(img[i], crc);
+		wr_flash(img[i], fptr++);
+	}
+	wr_flash((U8)(crc >> 8), fptr++);
+	wr_flash((U8)crc, fptr);
+}
+#endif
+
+//**************
+// End Of File
+//**************
@@ -0,0 +1,63 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: chstore.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the channel store module.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Added chs_chan() and CHS_FMT (CH_LOG).
+ *						Added chs_valid() and chs_maxvalid().
+ *						chs_chan() returns a CHS_MEM pointer (the expanded CH in RAM for CH_POOL).
+ *						CH_FREQ also returns a RAM copy.
+ *						Added chs_ppm() and chs_setppm() (unit config log).
+ *						Replaced them w/ chs_loadcfg() and chs_savecfg() (config image, pll.h).
+ *
+ *******************************************************************/
+
+#if CHS_PACK
+#define	CHS_MEM		idata			// chs_chan() returns a copy that is good until the next call
+#else
+#define	CHS_MEM		code
+#endif
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 chs_init(void);
+U16 chs_crc(void);
+U8 CHS_MEM * chs_chan(U8 chnum);
+U16 chs_crcrange(U16 off, U16 len);
+U16 chs_sectoff(U8 sect);
+void chs_recalc(void);
+void chs_hold(U8 on);
+void chs_wrbegin(U8 chnum);
+U8 chs_wrbyte(U8 c);
+void chs_wrend(void);
+void chs_erase(U8 sect);
+U8 chs_wrchan(U8 chnum, U8 idata * src);
+U8 chs_valid(U8 chnum);
+U8 chs_maxvalid(void);
+#if (CFG_CMD == 1)
+U8 chs_loadcfg(U8 idata * img);
+U8 chs_savecfg(U8 idata * img);
+#endif
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+// chs_init() returns
+#define	CHS_OK		0
+#define	CHS_CRCERR	1				// table CRC doesn't match the saved CRC
+#define	CHS_NOLOG	2				// CRC log is full (stale), not checked
+#define	CHS_RECOV	3				// an interrupted CH re-write was completed from the scratch sector
+#define	CHS_FMT		4				// CH_LOG: the log was (re)formatted
@@ -0,0 +1,24 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: crc.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the CRC16 module.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U16 calcrc(U8 c, U16 oldcrc);
+U16 crc_shift(U16 crc, U16 n);
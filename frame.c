@@ -0,0 +1,196 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: frame.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the SLIP frame codec for the binary cmd mode.
+ *             A frame is: END, seq, op, [arg, data...], CRC16 (msb first), END
+ *             with END/ESC bytes escaped.  The CRC (calcrc(), XMODEM poly) covers
+ *             seq through data.  RX frames are decoded in place in rxd_buff
+ *             (raw RX mode), so no frame buffer is needed.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Only built if BIN_CMD = 1.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "serial.h"
+#include "crc.h"
+#define FRAME_INCL
+#include "frame.h"
+
+#if (BIN_CMD == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	FEND		0xC0			// SLIP frame end
+#define	FESC		0xDB			// SLIP escape
+#define	FESC_END	0xDC			// escaped FEND
+#define	FESC_ESC	0xDD			// escaped FESC
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U8	fr_seq;							// rx frame seq#
+U8	fr_op;							// rx frame opcode
+U8	fr_arg;							// rx frame 1st data byte (0 if none)
+U8	fr_len;							// rx frame # data bytes (incl arg)
+U8	fr_i;							// rx decode index (rxd_buff offset)
+U8	fr_end;							// rx frame FEND index (rxd_buff offset)
+U16	fr_crc;							// tx CRC16
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+void fr_putc(U8 c);
+
+//-----------------------------------------------------------------------------
+// fr_rx() looks for a complete frame at the front of rxd_buff.  Returns FR_NONE
+//	if there isn't one, FR_OK if its CRC is good, else FR_BAD.  For FR_OK/FR_BAD,
+//	fr_seq/fr_op/fr_arg/fr_len are set, fr_byte() returns the data that follows
+//	fr_arg, and fr_done() must be called to remove the frame.
+//-----------------------------------------------------------------------------
+//
+U8 fr_rx(void){
+	U8	n;				// rx chrs
+	U8	k;				// # decoded bytes
+	U8	c;
+	U16	crc;
+
+	n = rxd_cnt();
+	while(n && (rxd_peek(0) == FEND)){
+		rxd_drop(1);						// skip leading/empty frame ends
+		n--;
+	}
+	for(fr_end=0; (fr_end<n) && (rxd_peek(fr_end)!=FEND); fr_end++);
+	if(fr_end == n){
+		if(n >= (RXD_MAX - 1)){
+			rxd_drop(n);					// too long to be a frame, discard
+		}
+		return FR_NONE;
+	}
+	fr_i = 0;
+	crc = 0;
+	fr_seq = 0;
+	fr_op = 0;
+	fr_arg = 0;
+	for(k=0; fr_i<fr_end; k++){
+		c = fr_byte();
+		crc = calcrc(c, crc);				// CRC of msg + its CRC16 is 0
+		if(k == 0) fr_seq = c;
+		if(k == 1) fr_op = c;
+		if(k == 2) fr_arg = c;
+	}
+	fr_i = 0;
+	for(n=0; (n<3) && (fr_i<fr_end); n++){
+		fr_byte();							// position fr_byte() at the data after fr_arg
+	}
+	if((k < 4) || (crc != 0)){
+		fr_len = 0;
+		return FR_BAD;
+	}
+	fr_len = k - 4;							// less seq, op, and CRC16
+	return FR_OK;
+}
+
+//-----------------------------------------------------------------------------
+// fr_byte() returns the next decoded byte of the rx frame
+//-----------------------------------------------------------------------------
+//
+U8 fr_byte(void){
+	U8	c;
+
+	if(fr_i >= fr_end) return 0;
+	c = rxd_peek(fr_i++);
+	if((c == FESC) && (fr_i < fr_end)){
+		c = rxd_peek(fr_i++);
+		if(c == FESC_END){
+			c = FEND;
+		}else{
+			if(c == FESC_ESC) c = FESC;
+		}
+	}
+	return c;
+}
+
+//-----------------------------------------------------------------------------
+// fr_done() removes the rx frame from rxd_buff
+//-----------------------------------------------------------------------------
+//
+void fr_done(void){
+
+	rxd_drop(fr_end + 1);
+}
+
+//-----------------------------------------------------------------------------
+// fr_start() starts a response frame.  Follow with fr_put() for data, and fr_send().
+//-----------------------------------------------------------------------------
+//
+void fr_start(U8 seq, U8 op, U8 status){
+
+	putch(FEND);
+	fr_crc = 0;
+	fr_put(seq);
+	fr_put(op);
+	fr_put(status);
+}
+
+//-----------------------------------------------------------------------------
+// fr_put() adds a data byte to the response frame
+//-----------------------------------------------------------------------------
+//
+void fr_put(U8 c){
+
+	fr_crc = calcrc(c, fr_crc);
+	fr_putc(c);
+}
+
+//-----------------------------------------------------------------------------
+// fr_send() ends the response frame
+//-----------------------------------------------------------------------------
+//
+void fr_send(void){
+	U16	crc;
+
+	crc = fr_crc;
+	fr_putc((U8)(crc >> 8));
+	fr_putc((U8)(crc & 0xff));
+	putch(FEND);
+}
+
+//-----------------------------------------------------------------------------
+// fr_putc() sends a byte with SLIP escapes
+//-----------------------------------------------------------------------------
+//
+void fr_putc(U8 c){
+
+	if(c == FEND){
+		putch(FESC);
+		c = FESC_END;
+	}else{
+		if(c == FESC){
+			putch(FESC);
+			c = FESC_ESC;
+		}
+	}
+	putch(c);
+}
+
+#endif
+
+//**************
+// End Of File
+//**************
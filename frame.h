@@ -0,0 +1,70 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: frame.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the binary cmd mode frame codec.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Added OP_CRC and OP_SCRC.
+ *						Fixed the OP_PGM reg order (R0 first), and added an example frame.
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// extern defines
+//------------------------------------------------------------------------------
+
+#ifndef FRAME_INCL
+extern U8 fr_seq;
+extern U8 fr_op;
+extern U8 fr_arg;
+extern U8 fr_len;
+#endif
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 fr_rx(void);
+U8 fr_byte(void);
+void fr_done(void);
+void fr_start(U8 seq, U8 op, U8 status);
+void fr_put(U8 c);
+void fr_send(void);
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+// fr_rx() returns
+#define	FR_NONE		0				// no complete frame
+#define	FR_OK		1
+#define	FR_BAD		2				// CRC or length error
+// opcodes.  Request: seq, op, [arg, data].  Response: seq, op, status, [data].
+#define	OP_SEL		0x01			// arg = ch#: send CH to the PLL (as the temp CH)
+#define	OP_PGM		0x02			// arg = ch#, data = 24 reg bytes (R0..R5, each msb first, as in the CH array)
+#define	OP_READ		0x03			// arg = ch#.  rsp data = 24 reg bytes
+#define	OP_LOCK		0x04			// rsp data = PLL lock (1/0)
+#define	OP_STAT		0x05			// rsp data = loaderr, preempt(2), lat_last(2), lat_max(2) (lat 0 if LAT_CMD = 0)
+#define	OP_ERASE	0x06			// arg = sector# (0 = CH00-15)
+#define	OP_CRC		0x07			// arg = 1st ch#, data = # ch.  rsp data = CRC16 (2) of the CHs
+#define	OP_SCRC		0x08			// arg = sector#.  rsp data = CRC16 (2) of the CH bytes in the sector
+#define	OP_HUMAN	0x7F			// return to the "pll>" cmd line
+// e.g., OP_PGM, seq 01, CH 02 = 1152 MHz (R0 = 0x00730010 ... R5 = 0x00580005, channels.c):
+//	C0 01 02 02 00 73 00 10 00 00 80 29 00 00 4E 42 00 00 04 B3 00 95 04 2C 00 58 00 05 3D 25 C0
+//	END seq op arg [R0         ][R1         ][R2         ][R3         ][R4         ][R5         ] CRC   END
+//	response (ST_OK): C0 01 02 00 51 52 C0.  A C0 or DB in seq..CRC is sent as DB DC or DB DD.
+// response status
+#define	ST_OK		0x00
+#define	ST_CRC		0x01			// CRC/framing error (seq and op may be invalid)
+#define	ST_OP		0x02			// unknown op or bad length
+#define	ST_ARG		0x03			// bad ch# or sector#
+#define	ST_FLASH	0x04			// FLASH verify error (CH not erased)
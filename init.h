@@ -14,6 +14,8 @@
  *  File scope declarations revision history:
  *    05-10-13 jmh:  creation date
  *    07-13-13 jmh:  removed typecast from timer defines & updates XTAL freq 
+ *    10-17-26 jmh:  added the optional serial cmd options (BULK_CMD, XM_CMD, BIN_CMD, CRCQ_CMD, SYN_CMD,
+ *						CFG_CMD) so that a build can be sized to fit below the CH sectors
  *
  *******************************************************************/
 
@@ -28,6 +30,8 @@
 //-----------------------------------------------------------------------------
 
 #define	NUM_CHAN	100		// define number of PLL channels for this build
+#define	REVC_HW 	1		// 1 = build for rev C hardware, else set to 0
+#undef	BB_SPI				// if defined, use bit-bang SPI, else use hdwr SPI
 
 // timer definitions.  Uses EXTXTAL #def to select between ext crystal and int osc
 //  for normal mode.
@@ -46,6 +50,35 @@
 #define TMRRUN		0
 
 #define MS_PER_TIC  1
+#define	T2_RELOAD	0xF806			// Timer2 reload value (1ms/tic, see Timer_Init())
+#define	T2_PER		(65536L - T2_RELOAD) // Timer2 counts per ms (~0.49 us/count)
+#define	CRC_TBL		1				// calcrc(): 0 = bitwise, 1 = nybble table (32B), 2 = byte table (512B)
+#define	CH_RWR		1				// 1 = re-write a pgmd CH thru the scratch sector, 0 = CH must be erased to pgm
+#define	CH_LOG		0				// 1 = log-structured CH store (chlog.c, NUM_CHAN <= 54),
+									//	0 = fixed CH array at CHAN_ADDR
+#define	CH_POOL		0				// 1 = CH array of 12 byte records, R2-R5 are indexes into a pool of
+									//	shared reg values (chpool.c), 0 = 24 byte CHs.  Not with CH_LOG.
+#define	CH_FREQ		0				// 1 = CH array of 5 byte records (frequency, power/flags), the regs are
+									//	synthesized w/ SYN_REF (chfreq.c).  Not with CH_LOG or CH_POOL.
+// optional serial cmds (1 = include).  The code must end below SECT00_ADDR (see the MEMORY MAP NOTE in
+//	main.c), and they don't all fit w/ the rest of the code: check the BL51 map after enabling one.
+//	The sizes noted are estimates of the code and DATA each one adds (not from a BL51 map).
+#define	BULK_CMD	0				// "U" bulk upload (~550 B code, 1 B DATA)
+#define	XM_CMD		0				// "X" XMODEM send/receive (xmodem.c, ~1.5 KB code, 12 B DATA)
+#define	BIN_CMD		0				// "#" binary framed cmds (frame.c, ~1.1 KB code, 8 B DATA)
+#define	CRCQ_CMD	0				// "C" sector/CH range CRC queries (~420 B code, 4 B DATA)
+#define	SYN_CMD		0				// "F" reg synthesis (synth.c, ~1.3 KB code, no added DATA)
+#define	CFG_CMD		0				// "K"/"O" ref correction and reg overlays (saved config, pll.c/chstore.c,
+									//	~2.9 KB code, 13 B DATA w/ OVL_NUM = 1)
+#define	LAT_CMD		0				// "T" edge to LE time, and in OP_STAT (16 B of RAM)
+#define	SLICE_CMD	0				// "S"/"SR" task slice and CRC times (8 B of DATA, 10 B of main() and 8 B of do_cmd() locals)
+// ADF4351 reg synthesis (SYN_CMD, synth.c).  Frequencies are in 10 Hz units.
+#define	SYN_REF		1000000L		// reference osc (10 MHz)
+#define	SYN_SPC		10000L			// default channel spacing (100 KHz)
+#define	SYN_PWR		0				// default output power (0 = -4 dBm, 1 = -1, 2 = +2, 3 = +5 dBm)
+#define	OVL_NUM		1				// # reg overlays (CFG_CMD, pll.c).  Saved w/ the config (max 3, CFG_LEN).
+									//	Each one past the first adds 9 B of DATA (OVL_NUM = 3: 31 B over CFG_CMD = 0)
+#define	DBOUNCE_MS		(5/MS_PER_TIC)	// port input settle time (FSEL/PTT must be stable this long)
 // General timer constants
 #define MS50        	(50/MS_PER_TIC)
 #define MS100       	(100/MS_PER_TIC)
@@ -81,16 +114,39 @@
 // Global variables
 //-----------------------------------------------------------------------------
 
+// event time stamp (ms_uptime + Timer2 count)
+typedef struct {
+	U16	ms;								// ms_uptime (ls 16b)
+	U16	t2;								// TMR2 count
+} TSTAMP;
+
+// cooperative task loop ready bits (task_rdy), in priority order.  ISRs use |= only (ORL is atomic).
+#define	TSK_PORT	0x01			// FSEL/PTT inputs settled
+#define	TSK_PLL		0x02			// PLL register set sent
+#define	TSK_CMD		0x04			// serial input, cmd timer, or cmd continuation
+#define	TSK_OUT		0x08			// TX buffer space, or status msg pending
+#define	NUM_TASK	4
+
+extern U32 ms_uptime;				// timer.c
 #ifndef IS_MAINC
-extern U8 spi_tmr;
+extern U8 task_rdy;
 #endif
 
+// take a time stamp.  Only use from an ISR at the same priority as Timer2, or with intrpts off.
+//	Timer2 is read MSB, LSB, MSB to catch a carry between the reads.  If the ms overflow is still
+//	pending, the count has just reloaded, so the ms count is advanced.
+#define	T2_STAMP(s)	{ (s).t2 = ((U16)TMR2H << 8) | TMR2L; \
+					  if(TMR2H != (U8)((s).t2 >> 8)) (s).t2 = ((U16)TMR2H << 8) | TMR2L; \
+					  (s).ms = (U16)ms_uptime; \
+					  if(TF2H && ((s).t2 < (T2_RELOAD + (T2_PER / 2)))) (s).ms++; }
+
 //-----------------------------------------------------------------------------
 // Prototypes
 //-----------------------------------------------------------------------------
 
 void Init_Device(void);
 void wait(U16 waitms);
+void poll_port(void);
 
 //-----------------------------------------------------------------------------
 // End Of File
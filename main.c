@@ -24,31 +24,105 @@
  *
  *!!!!!!!!!!!!!!!!!!!!!!
  *	MEMORY MAP NOTE:
- *		Because of how the memory is allocated and initialized by the cource code, the Program size
- *		as reported by the Keil compiler (code) is limited to 7518 bytes.  If this number is equalled or exceeded,
- *		the code space will have encroached on the channel sectors.  In this case, either the number of channels
- *		must be decreased, or the code must be optimized to reduce its size.  There will likely not be a
- *		compiler warning if this happens.  The channel FLASH space is included in the compiler report.
- *		Thus, the available FLASH space for program code is calculated by the eqn:
- *			  Remaining code FLASH = 0x1dfe - Program_size_code - 160
- *				^						^			^				^
- *				|						|			|				|__ space wasted in channel sectors
- *				|						|			|___ size reported by compiler
- *				|						|___ top of useable FLASH
- *				|___ space available for new code
- *
- *		The largest value reported from the compiler (given the current waste value of 160 bytes) would be
- *		Program_size_code(max) = (0x1dfe - 160) = 7518
- *		If the channel space is modified, the wasted space value may change and this must be taken into account
- *		if this action is taken.
- *		Since FLASH erase operates on sectors (512 bytes for the F530), The channels must be placed within sectors
- *		that contain no other data.  The current schema aligns the channels with an offset of 128 to provide
- *		scratchpad space and align the channels so that CH16 starts on the next sector.  The number of sectors
- *		required is calculated by dividing the channel space by 512 and rounding up.  Each channel occupies 24
- *		bytes (6, 4-byte registers), so 100 channels occupies 2400 bytes.
+ *		FLASH map (see channels.h, SECTOR_SIZE = 512):
+ *			0x0000 - 0x11FF		program code (and code constants)
+ *			0x1200 - 0x123F		CH table CRC16 log (chstore.c)
+ *			0x1240 - 0x127F		CH re-write journal (CH_RWR)
+ *			0x1280 - 0x1BDF		CH table (24 bytes/CH, 100 CH = 2400 bytes), or the CH_POOL/CH_FREQ
+ *								records and pool, or (CH_LOG) the CH log in 0x1200 - 0x1BFF
+ *			0x1BE0 - 0x1BFF		unit config log (CFG_CMD: "K"/"O")
+ *			0x1C00 - 0x1DFE		scratch sector (CH re-write, CH_LOG config log)
+ *			0x1DFF				FLASH lock byte (LOCK_ADDR).  0x1DFE is the top of useable FLASH, and the
+ *								page above it (0x1E00 - 0x1FFF) is reserved by SiLabs.  The scratch sector
+ *								is the lock byte page: it is erased at run time (which leaves the part
+ *								unlocked), but the lock byte is never written, so don't lock the part.
+ *		The sectors from 0x1200 up are erased and re-written at run time, so no code may be placed
+ *		there: the code must end below 0x1200 (4608 bytes).  The project IROM size is set to 0x1200
+ *		so that BL51 reports an overflow instead of placing code in the CH sectors (only the flat CH
+ *		table, ?CO?CHANNELS, is located above it).  The baseline V1.7 code was about 0xFB2 bytes, so
+ *		the optional serial cmds (BULK_CMD, XM_CMD, BIN_CMD, CRCQ_CMD, SYN_CMD, CFG_CMD in init.h) are
+ *		off by default.  Check the CODE size in the BL51 map (.M51) after enabling any of them.
+ *		Rev 1.7 has not been sized by BL51 yet.  A source estimate (C tokens scaled to the baseline's
+ *		code size) puts the default build at about 0x2180 bytes, more than the whole part: it will
+ *		not link until the Rev 1.7 core (task loop, ISR drivers, CH store) is cut down, or it moves
+ *		to a part with more FLASH.  CH_RWR = 0 saves about 0x380 bytes.
  *!!!!!!!!!!!!!!!!!!!!!!
  *
  *  Project scope revision history:
+ *    10-17-26 jmh:  Rev 1.7, HWrevC (development)
+ *						Added register shadow and send_pll().  Only registers that differ from the last set sent
+ *							to the ADF4351 are transferred.  R0 is still sent last, and is sent if it changed, if
+ *							R1-R3 changed, or if a double-buffered R4 divider changed.  A power or divider change
+ *							in R4 alone no longer re-triggers VCO band selection.
+ *						Moved the SPI driver to pll.c.  HWSPI register sets are now clocked out by the SPI0 and
+ *							Timer0 ISRs, so the main loop continues while a set is being sent.
+ *						Replaced the wait(50) after each port change with a settle timer (dbounce_tmr, DBOUNCE_MS).
+ *							Port inputs must be stable for DBOUNCE_MS before they are acted on, and the PLL is
+ *							queued before the status message is sent.
+ *						Serial output is buffered and sent by the UART ISR.  Channel status messages are sent
+ *							with the TXD_TRUNC policy so that they never wait on the serial port.
+ *						Moved FSEL/PTT processing to poll_port().  It is called from the main loop, and from the
+ *							wait loops inside commands (wait(), erase confirm, and putch() when the TX buffer is
+ *							full), so a PTT or FSEL change re-programs the PLL in the middle of a long command
+ *							("r-", "EA", "z").  The CH status message is deferred until the command completes.
+ *							The number of in-command updates is reported by "Q".
+ *						FSEL/PTT changes are now detected by the port match intr, which re-arms the match regs,
+ *							restarts the settle timer, and time stamps the first edge.  The main loop idles
+ *							the CPU when there is nothing to do.  "T" reports the edge to LE time (us).
+ *						Replaced the main loop with a cooperative task loop (port, PLL, cmd, and output tasks)
+ *							that is driven by task_rdy bits set from the ISRs.  Erase confirm/erase, CRC (c/z),
+ *							and "r" dumps are now run a slice at a time, so the port task is never held off
+ *							longer than one slice.  The z cmd 1 sec delay no longer uses wait().
+ *							"S" reports the max slice time of each task.
+ *						Added the timer service (timer.c).  Timer2_ISR moved there, and the settle, cmd, and
+ *							wait() timeouts are now software timers.  Removed the unused spi_tmr.
+ *						Added "Bn" to set the baud rate (up to 115200).  The rate reverts to 9600 if no valid
+ *							cmd arrives at the new rate within BAUD_TMO.  "Q" reports RX buffer overflow.
+ *						Added "U" bulk upload.  A stream of "M" lines is programmed one record per slice, with
+ *							XON/XOFF flow control, and ends with "." (or BULK_TMO).  The pgmd/err counts and
+ *							the table CRC16 are reported at the end.
+ *						Added "XR"/"XS" XMODEM-CRC receive/send of the channel image (xmodem.c).  Received
+ *							blocks are written to FLASH as they arrive.
+ *						Added "#" binary framed cmd mode.  SLIP frames with a seq#, opcode, and CRC16 trailer
+ *							(frame.c/h) cover select/program/read CH, lock, stats, and sector erase.  Each
+ *							request gets one response frame with a status byte.
+ *						Moved calcrc() to crc.c.  CRC_TBL selects a bitwise, nybble table, or byte table CRC.
+ *						Channel FLASH writes/erases now go through chstore.c, which keeps the table CRC16 current
+ *							(incremental update) and logs it in the gap below CHAN_ADDR.  "c"/"z" use the kept CRC,
+ *							and a table that doesn't match the logged CRC at boot is reported as "CRCERR".
+ *						"M"/"P" can now re-program a pgmd CH (CH_RWR): its sector(s) are re-written through the
+ *							scratch sector at SCRATCH_ADDR.  "RWREC" at boot reports a re-write finished after a power loss.
+ *						Added the CH_LOG build option: a log-structured, wear-leveled CH store (chlog.c).  All CH reads
+ *							go through chs_chan(), and U/OP_PGM now use chs_wrchan() (so they can re-write a pgmd CH).
+ *						Max-valid mode and the empty CH fallback use the valid CH bitmap (chs_maxvalid(), chs_valid()).
+ *						"r" takes a CH range (rnn-mm), and options to skip empty CHs (v) and drop the spaces (t).
+ *						Erase/CRC sector counts come from NUM_SECT (only the sectors NUM_CHAN uses), and added
+ *							"Exx-yy" to erase the sectors that hold CH xx thru yy.
+ *						Added the CH_POOL build option (chpool.c): 12 byte CH records w/ a pool of shared R2-R5
+ *							values.  Like CH_LOG, there are no CH sector cmds, and "E16"/"Exx-yy" blank the CHs.
+ *						Added "F" to set the temp channel to the regs for a frequency (synth.c).
+ *						Added the CH_FREQ build option (chfreq.c): 5 byte frequency CH records, synthesized when
+ *							read (CH00 and the last CH are cached).  "F" p also takes the MTLD/PD flags.
+ *						Added "K" to read/save the reference ppm correction (applied by send_pll()).
+ *						Added "O" reg overlays (AND/OR masks applied by send_pll()), saved w/ "OW" or "K".
+ *						"z" compares the kept CRC at once (dropped CMD_ZWAIT and its 1 sec delay).
+ *						chs_init() and chs_loadcfg() run before the POR port update (EA = 1, wait()).
+ *						Updated the MEMORY MAP NOTE (code must end below 0x1200, project IROM = 0x1200).  "U",
+ *							"X", "#", "C", "F", and "K"/"O" are build options (init.h), off by default.
+ *							So are "T"/"S" (STAT_CMD), to save RAM (256 B, no XRAM).
+ *						"T" (and the OP_STAT edge to LE times) is its own build option, LAT_CMD.
+ *						"S" (task slice times) is SLICE_CMD.
+ *						Added "C" (CRC16 of each sector, or of a CH range) and binary OP_CRC/OP_SCRC so a host
+ *							can find and re-program just the sectors/channels that differ.
+ *						"F" reads the power/flags field as a number (0-15) and needs a space before the spacing.
+ *						"On" masks starting w/ C or W no longer also run "OC"/"OW".
+ *						OP_READ re-fetches each CH byte (the chs_chan() buffer can change while the rsp is sent).
+ *						"XR" checks that the CHs are erased before it starts.
+ *						Added the Rev 1.7 code size estimate to the MEMORY MAP NOTE.
+ *						The CH status msg is held until it fits in the TX buffer (the POR msg was cut to "C"
+ *							behind the sign-on msg at 9600 baud).
+ *						Documented "Bn" and the 9600 fallback in the serial protocol notes.
+ *						Added "SR" (SLICE_CMD): the time of a CRC16 over the CH table, to compare CRC_TBL builds.
  *    08-11-18 jmh:  Rev 1.6, HWrevC (released)
  *						Changed delay_halfbit to use HW timer0 instead of cheesy for-loop
  *						Converged delay_halfbit into a single Fn for BB/HWSPI.  Now, base timer value for delay half-bit
@@ -98,9 +172,6 @@
  *
  ***************************************************************************************/
 
-#define	REVC_HW 	1		// 1 = build for rev C hardware, else set to 0
-#undef	BB_SPI				// if defined, use bit-bang SPI, else use hdwr SPI
-
 //--------------------------------------------------------------------------------------
 // main.c
 //      Uses a C8051F531-C-IT processor to program the ADF4351 PLL chip registers.
@@ -152,10 +223,12 @@
 //
 //      UART: 9600 baud, Simple I/O protocol
 //
-//      Timer0: n/u
+//      Timer0: SPI LE setup/hold and inter-word delay (pll.c)
 //      Timer1: UART baud rate (9600 baud)
 //      Timer2: Application timer (1ms/tic)
 //
+//      Port match: P1 (FSEL) and P0.3 (/PTT) change intr
+//
 //      ADC: n/u
 //
 //      PCA: n/u
@@ -181,8 +254,9 @@
 //			Note: this limits available code space to 4K (4096 bytes)
 //
 //		Serial protocol:
-//		EA/E16
-//			ErAse all channels, or Erase ch16+
+//		EA/E16/Exx-yy
+//			ErAse all channels, Erase ch16+, or Erase the sectors that hold ch xx thru yy (CHs that
+//			share those sectors are erased too, the prompt shows the CHs that will be erased).
 //			prompts "Erase all, press Y to accept" and waits 5 sec for input.  Any character
 //			other than upper-case "Y", or a delay of more than 5 sec will cause this command to abort.
 //
@@ -203,14 +277,39 @@
 //			Selecting a new BCD channel, or programming a channel with the "M" command will cancel
 //			the temp channel.  The temp channel command must then be be re-entered if needed.
 //
+//		F fff.fffff [p [sss.ss]]		(SYN_CMD = 1)
+//			Sets the temp channel (as "t") to the regs calculated for fff.fffff MHz (10 Hz resolution),
+//			output power p (0 = -4, 1 = -1, 2 = +2, 3 = +5 dBm, default SYN_PWR, add 4 for mute till
+//			lock detect, and 8 for PLL power down), and channel spacing sss.ss KHz (default SYN_SPC,
+//			only used if the exact frequency can't be set).  Use "Pxx" to save it to channel xx
+//			(CH_FREQ: only at the default spacing).
+//
+//		K [+/-ppp.pp]				(CFG_CMD = 1)
+//			Saves the reference osc correction, in ppm (+ = the ref is high), and re-sends the
+//			channel.  The correction is applied to every channel sent (the stored channels are not
+//			changed).  "K" alone displays it.  (Saves the unit config, which includes the overlays.)
+//			The corrected INT/FRAC/MOD is the nearest with MOD <= 4095: typ within a few ppb, but a
+//			channel whose corrected N is near an integer (e.g., an integer-N CH) is only within
+//			1 / (8190 * N), i.e. 1.2 ppm @ N = 100, 0.3 ppm @ N = 400.
+//
+//		On aaaaaaaa oooooooo		(CFG_CMD = 1)
+//			Sets an overlay on reg Rn (0-5): every channel sent has Rn = (Rn & aaaaaaaa) | oooooooo
+//			(hex, the control bits are not changed), and re-sends the channel.  Up to OVL_NUM regs
+//			can have an overlay.  "On" clears the Rn overlay, "OC" clears all, "O" lists them, and
+//			"OW" saves them (with the ppm correction) so they are restored at boot.  E.g., "O4
+//			FFFFFFE7 00000018" sets +5 dBm, "O4 FFFFFFDF 00000000" turns the RF output off.
+//
 //		rxx
 //			Read channel "xx" (xx is BCD ASCII '00' thru '99')
 //		rr
 //			Read temp channel
 //		r-
 //			Read all channels
+//		rxx-yy
+//			Read channels "xx" thru "yy"
 //			Channel data is output in the "M" entry format described above with spaces inserted
-//			between register fields.
+//			between register fields.  Any of the above may be followed by option letters:
+//			"v" skips empty channels (R5 = ffffffff), and "t" (terse) leaves out the spaces.
 //
 //		i
 //			re-send last resister set to the ADF4351.  Re-sends current register selection (BCD or temp) based on
@@ -219,6 +318,13 @@
 //		e
 //			echo command line.  This is a debug command that will echo the characters on the command line.
 //
+//		Bn
+//			Sets the baud rate, n = 0: 9600, 1: 19200, 2: 57600, 3: 115200.  The reply is sent at the old
+//			rate, then the rate is changed.  If no valid cmd arrives at the new rate within BAUD_TMO
+//			(10 sec), the rate reverts to 9600 and "baud 9600" is sent.  To check the fallback, send "B3"
+//			from a 9600 baud terminal and stay at 9600: "baud 9600" and the prompt show 10 sec later.
+//			At a higher rate, "Q" reports "RX ovf" if the host outran the RX buffer.
+//
 //		All commands are terminated with <CR> ('\r').
 //		Serial port does not echo characters.
 //
@@ -244,6 +350,13 @@
 //#include "version.h"
 #include "channels.h"
 #include "flash.h"
+#include "pll.h"
+#include "timer.h"
+#include "xmodem.h"
+#include "frame.h"
+#include "crc.h"
+#include "chstore.h"
+#include "synth.h"
 
 //-----------------------------------------------------------------------------
 // Definitions
@@ -254,13 +367,32 @@
 #define	PBMAX	100				// max channel #s (2-digit BCD input)
 #define	PBMVAL	254				// indicates max-valid channel mode is active
 #define	MAX_REG	24				// max bytes in an ADF4351 reg set
+#define	CRC_SLICE	24			// bytes per CRC query slice (1 channel)
+#define	CH_BAD		0xFF		// get_chnum(): invalid ch#
+#define	DEC_BAD		0xFFFFFFFFL	// get_dec(): overflow
+#define	PPM_MAX		30000		// max "K" ref correction (0.01 ppm)
+#define	CHMSG_NONE	0xFF		// ch_msg: no status msg pending
+#define	CHMSG_TMP	0xFE		// ch_msg: temp channel selected
+#define	CHMSG_LEN	11			// TX buffer space for a status msg ("CH nn\r\npll>").  <= 15 - TXD_WAKE
+// cmd_state continuations (see cmd_task())
+#define	CMD_IDLE	0			// waiting for a cmd line
+#define	CMD_ERCONF	1			// erase: waiting for "Y"
+#define	CMD_ERASE	2			// erase: one sector per slice
+#define	CMD_CRC		3			// C: CRC_SLICE bytes per slice
+#define	CMD_DUMP	4			// r: channel dump (see out_task())
+#define	CMD_BULK	5			// U: bulk upload, one record per slice
+#define	CMD_XM		6			// X: XMODEM transfer (see xmodem.c)
+#define	CMD_BIN		7			// #: binary framed cmd mode, one frame per slice
+#define	BULK_TMO	MS10000		// bulk upload ends if no record arrives in this time
+#define	BULK_NONE	0xFD		// bulk_rec(): empty line
+#define	BULK_END	0xFE		// bulk_rec(): end of upload (".")
+#define	BULK_ERR	0xFF		// bulk_rec(): record error
+#define	DUMP_FLD	12			// TX buffer space needed for one dump field ("XXXXXXXX " or "\r\n").  <= 15 - TXD_WAKE
 
 //-----------------------------------------------------------------------------
 // External Variables
 //-----------------------------------------------------------------------------
 
-U8  spi_tmr = 0;
-
 //-----------------------------------------------------------------------------
 // Main Variables
 //-----------------------------------------------------------------------------
@@ -270,50 +402,94 @@ U8  spi_tmr = 0;
 sbit PB0		= P1^0;				// (i) button input 0
 sbit PB1		= P1^1;				// (i) button input 1
 sbit PB2		= P1^2;				// (i) button input 2
-sbit SCK        = P0^0;				// (o) SPI SCLK
-sbit MISO       = P0^1;				// (i) SPI MISO/LDET
-sbit MOSI       = P0^2;				// (o) SPI MOSI
 sbit nPTT		= P0^3;				// (i) /PTT input
-sbit nPLL_LE	= P0^7;				// (o) SPI LE
-
-#if (REVC_HW == 1)
-#define	LE_ON	1
-#define	LE_OFF	0
-#else
-#define	LE_ON	0
-#define	LE_OFF	1
-#endif
-
-#if (REVC_HW == 1)
-#define	PLL_LOCK	0
-#else
-#define	PLL_LOCK	1
-#endif
 
 //-----------------------------------------------------------------------------
 // Local variables
 //-----------------------------------------------------------------------------
 //U16 temptimer; // = 0;
-U16 waittimer; // = 0;              // wait() function timer
-U8	dbounce_tmr;
 U8	iplTMR; // = TMRIPL;            // timer IPL init flag
+#if CHS_FLAT
 U32* pll_ch;						// pointer to base of channel array (initialized in main())
+#endif
+U8	PBreg;							// PB memory
+U8	PBraw;							// PB settle detect
+U8	PTTreg;							// PTT memory
+U8	PTTraw;							// PTT settle detect
+bit	temp_active;					// temp reg active flag
+bit	in_cmd;							// serial cmd is being processed
+U8	ch_msg;							// channel status msg to send (CH#, CHMSG_TMP, or CHMSG_NONE)
+U16	preempt_cnt;					// # PLL updates made while a serial cmd was running
+U8 idata temp_chan[MAX_REG];		// temp channel register set (bytes)
+#if (LAT_CMD == 1)
+TSTAMP	edge_stamp;					// time of the 1st port edge since the last update (port_intr)
+TSTAMP	lat_edge;					// edge_stamp for the update in progress
+bit	edge_pend;						// edge_stamp is valid
+bit	lat_pend;						// PLL update in progress, measure latency when done
+U16	lat_last;						// last edge to LE time (us)
+U16	lat_max;						// max edge to LE time (us)
+#endif
+#if (SLICE_CMD == 1)
+U16	task_max[NUM_TASK];				// max slice time for each task (us)
+#endif
+U8	task_rdy;						// ready tasks (TSK_xxx bits, see init.h)
+U8	cmd_state;						// cmd continuation (CMD_xxx)
+bit	loaderr;						// channel pgm error flag
+// cmd continuation context
+bit	cx_flag;						// E16 / C sector list / temp chan dump
+bit	cx_skip;						// dump: skip empty CH
+bit	cx_terse;						// dump: no spaces
+U8	cx_idx;							// sector or ch#
+U8	cx_cnt;							// # channels to dump / # bulk channels pgmd
+#if (BULK_CMD == 1)
+U8	cx_err;							// # bulk record errors
+#endif
+U8	cx_fld;							// dump field
+#if (CRCQ_CMD == 1)
+U16	cx_len;							// # bytes left to CRC ("C")
+U16	cx_crc;							// CRC16 accumulator ("C")
+#endif
+U8 CHS_MEM * cx_ptr;				// channel data pointer
 
 //-----------------------------------------------------------------------------
 // Local Prototypes
 //-----------------------------------------------------------------------------
 
-void send_spi32(U32 plldata);
-void delay_halfbit(void);
-U16 calcrc(U8 c, U16 oldcrc);
+void poll_port(void);
+void pll_task(void);
+void out_task(void);
+void cmd_task(void);
+void cmd_done(void);
+void do_cmd(void);
+#if (BIN_CMD == 1)
+void bin_cmd(void);
+#endif
+#if (BULK_CMD == 1)
+U8 bulk_rec(void);
+#endif
+#if (LAT_CMD == 1) || (SLICE_CMD == 1)
+U16 stamp_us(TSTAMP* a, TSTAMP* b);
+#endif
 void wait(U16 waitms);
 //void pb_state(U8 imode);
 U32 *get_chan(U8 chanum);
 U8 conv_to_chnum(U8 portbits);
 void put_hex(U8 dhex);
+#if (CFG_CMD == 1)
+void put_hex32(U32 d);
+#endif
 void put_dec(U8 dhex);
+void put_dec16(U16 d);
+void put_crc(U16 crc);
+#if CHS_FLAT && (CRCQ_CMD == 1)
+void crc_sect(U8 sect);
+#endif
 U8 convnyb(U8 c);
 U8 getbyte(U8* dataptr);
+U8 get_chnum(void);
+#if (SYN_CMD == 1) || (CFG_CMD == 1)
+U32 get_dec(U8 ndp);
+#endif
 U8 whitespc(char c);
 
 //******************************************************************************
@@ -321,62 +497,82 @@ U8 whitespc(char c);
 //  The main function inits I/O and process inputs.
 //	sends PLL data to ADF4351 when channel select inputs change
 //
+//	After init, main() runs a cooperative task loop.  Each task runs until it yields (returns).
+//	Tasks are made ready by setting their TSK_xxx bit in task_rdy, either from an ISR or from
+//	another task:
+//		TSK_PORT:	FSEL/PTT settle timer (TMR_PORT) expired, or "i"/"t" cmd.
+//		TSK_PLL:	register set sent to the PLL (spi_t0_intr).
+//		TSK_CMD:	chr received (rxd_intr), TMR_CMD expired, or cmd continuation.
+//		TSK_OUT:	TX buffer has room (rxd_intr), or channel status msg/dump pending.
+//	One task runs per pass, highest priority (lowest bit) first, so a port change waits for
+//	at most one slice.  Long cmds are split into slices (see cmd_state).  The max time of each
+//	task's slice is kept in task_max[] ("S" cmd, SLICE_CMD = 1).
+//
 //******************************************************************************
 void main(void) //using 0
 {
-	char c;				// temp term chr
-	bit	ipl;			// initial loop flag
-	U8	i;				// loop counter
-	U8	j;				// loop counter
-	U8	k;				// loop counter
-	U8	maxtemp;		// maxval temp port reg
-	bit	flag;			// temp flag
-	bit	goteol;			// temp flag
-	U8	PBreg;			// PB memory
-	U8	PBtemp;			// PB temp holding
-	U8	PTTtemp;		// PTT temp holding reg
-	U8	PTTreg;			// PTT memory
-	U8	CHtemp;			// channel temp
-	bit	temp_active;	// temp reg active flag
-	bit loaderr;		// channel pgm error flag
-	U8	pgm_chnum;		// prog chan temp
-	U8	tempbyte;		// prog byte temp
-	U8	tempbyte2;		// prog byte temp
-	U8	temp_chan[24];	// temp channel register set (bytes)
-	bit	z_temp;			// "z" cmd flag
-	U16	temp_crc;		// crc temp
-	U16 ii;				// crc temp
-	U32	temp32;			// 32 bit temp
-	U32* tptr;			// reg pointer
-	U8 xdata * fptr;	// flash pointer
-	U8 code * rptr;		// flash pointer
+	U8	t;				// task#
+	U8	m;				// task bit
+#if (SLICE_CMD == 1)
+	U16	us;				// slice time
+	TSTAMP	ts;			// slice start
+	TSTAMP	te;			// slice end
+#endif
 	
 	// start of main
 	PCA0MD = 0x00;							// disable watchdog
 	// init MCU system
 	Init_Device();							// init MCU
-#ifndef	BB_SPI
-    XBR0      = 0x03;						// enable hdwr SPI on xbar
-    SPI0CN    = 0x01;						// enable hdwr SPI
-#endif
-	SCK = 0;								// init SPI pins
-	MISO = 1;
-	nPLL_LE = LE_OFF;
+	init_pll();								// init SPI and PLL driver
 	init_flash();							// init FLASH
+	init_timer();							// init ms timer service
 	P1 = 0xFF;								// enable port for input
-	PBreg = P1;								// init PB memory
+	P0MASK = 0x08;							// port match on /PTT..
+	P1MASK = 0xFF;							// ..and FSEL[7:0]
+	P0MAT = P0;
+	P1MAT = P1;
+	PBraw = ~P1;							// init settle detect (POS logic, as port_intr)
+	PBreg = PBraw;							// init PB memory
 	PTTreg = ~nPTT;							// force PTT edge det for POR
+	PTTraw = nPTT;
+	tmr_start(TMR_PORT, DBOUNCE_MS, 0);
+	temp_active = 0;						// de-activate temp reg
+	in_cmd = 0;
+	ch_msg = CHMSG_NONE;
+	preempt_cnt = 0;
+#if (LAT_CMD == 1)
+	edge_pend = 0;
+	lat_pend = 0;
+	lat_last = 0;
+	lat_max = 0;
+#endif
+#if (SLICE_CMD == 1)
+	for(t=0; t<NUM_TASK; t++){
+		task_max[t] = 0;
+	}
+#endif
+	task_rdy = 0;
+	cmd_state = CMD_IDLE;
+	EIE1 |= 0x80;							// enable port match intr
+#if CHS_FLAT
 	pll_ch = pll_ch_array;					// set array to point to fixed location
+#endif
 	init_serial();							// init serial module
 	// init module vars
 	iplTMR = TMRIPL;                        // timer IPL init flag
+	loaderr = 0;							// init chan error status
+	t = chs_init();							// check the channel table against its saved CRC (before the
+											// ..POR port update: valid CH map, CH_LOG head)
+#if (CFG_CMD == 1)
+	chs_loadcfg((U8 idata *)&pll_cfg);		// saved ref correction and reg overlays
+#endif
 	EA = 1;
 	wait(50);                               // 50 ms delay
 	
 #if (REVC_HW == 1)
-	putss("\nADF4351 PLL Driver Ver 1.6, de ke0ff\n");	// send sw version msg to serial port
+	putss("\nADF4351 PLL Driver Ver 1.7, de ke0ff\n");	// send sw version msg to serial port
 #else
-	putss("\nADF4351 PLL Driver Ver A1.6, de ke0ff\n");	// send sw version msg to serial port
+	putss("\nADF4351 PLL Driver Ver A1.7, de ke0ff\n");	// send sw version msg to serial port
 #endif
 #if NUM_CHAN > 100
 	putss("Err");							// compile-time err
@@ -393,548 +589,1423 @@ void main(void) //using 0
 		putss("FLERR\n");
 		RSTSRC = 0x42;
 	}
-	temp_active = 0;						// de-activate temp reg
-	loaderr = 0;							// init chan error status
+	if(t == CHS_RECOV){
+		putss("RWREC\n");					// finished an interrupted CH re-write
+	}
+	if(t == CHS_CRCERR){
+		putss("CRCERR\n");
+		loaderr = 1;
+	}
+	if(t == CHS_FMT){
+		putss("CHFMT\n");					// CH_LOG: new log (the CHs must be loaded)
+	}
 //	RSTSRC = PORSF;
-	ipl = 1;								// set initial loop
+	task_rdy |= TSK_PORT | TSK_CMD;			// process POR port state and any early input
 	
 	// main loop
 	// PB0 is a toggle switch that selects one of two channels.  Flip the switch to send the opposite channel
 	while(1){
-		PBtemp = (~P1);								// convert port to POS logic
-		PTTtemp = nPTT;
-		if((PBtemp != PBreg) || (PTTtemp != PTTreg)){ // look for a change in port state
-			// this only runs if there is a change in state
-			maxtemp = 0xff;							// invalid maxtem
-//			if((PTTtemp != PTTreg) || ((PTTtemp == PTTreg) && (PTTreg == 0))){ // if(pttedge OR (!pttedge && ptt==gnd))...
-			if((PTTtemp != PTTreg) || (PTTreg == 0)){ // if(pttedge OR (!pttedge && ptt==gnd))...
-				if((PBtemp & 0x0f) > 0x09){			// look for "max valid search" semaphore (any non-BCD in 1's digit)
-					maxtemp = PBtemp;				// save port reg so we can preserve the change detect logic..
-					CHtemp = (NUM_CHAN + 1);		// ..because we are going to use PBreg to squeeze in the max chan selection
-					do{
-						CHtemp -= 1;
-						tptr = get_chan(CHtemp);	// calc tptr to R5 of correct channel array
-					}while((*tptr == 0xFFFFFFFF) && (CHtemp != 0));
-					i = CHtemp / 10;				// set PBtemp = BCD code for max valid channel#
-					PBtemp = CHtemp - (i * 10);		// LSnyb = 1's (remainder)
-					PBtemp |= i << 4;				// MSnyb = 10's
-				}
-			}
-			CHtemp = 0;								// set CH0 as default
-			if(PTTtemp != PTTreg){
-				PTTreg = PTTtemp;					// update edge detect
-				PBreg = PBtemp;						// copy the new port state to memory just in case it chaged at same time as PTT
-				if(PTTreg == 0){					// if PTT active (grounded):
-					CHtemp = conv_to_chnum(PBreg);	// convert port state to channel#
-				}
-			}else{
-				PBreg = PBtemp;						// copy the new port state to memory
-				temp_active = 0;					// abandon temp regs
-				if(PTTreg == 0){					// only update PLL if PTT = gnd
-					CHtemp = conv_to_chnum(PBreg);	// convert port state to channel#
-				}
-			}
-			if(CHtemp <= PBMAX){					// if valid channel#:
-				if((!temp_active) || (CHtemp == 0)){
-					putss("CH ");					// send status msg (at 9600 baud, this gives us > 10ms of debounce)
-					put_dec(CHtemp);				// print ch#
-					tptr = get_chan(CHtemp);		// calc tptr to R5 of correct channel array
-					if(*tptr == 0xffffffff) tptr = get_chan(0);	// default to ch#00 if R5 is 0xffffffff (i.e., ch is empty)
-					for(i=6;i!=0;i--){
-						send_spi32(*tptr--);		// transfer channel data to PLL
-					}
-				}else{
-					putss("tmp");					// do temp channel
-					for(i=6; i!=0; i--){
-						k = (i-1) * 4;
-						temp32 = (U32)temp_chan[k++] << 24;
-						temp32 |= (U32)temp_chan[k++] << 16;
-						temp32 |= (U32)temp_chan[k++] << 8;
-						temp32 |= (U32)temp_chan[k];
-						send_spi32(temp32);			// transfer channel data to PLL
-					}
-				}
-			}
-			if(maxtemp != 0xff){
-				PBreg = maxtemp;					// update port reg to hold setting
-			}
-			wait(50);								// debounce
-			putss("\npll>");						// post prompt
+		if(task_rdy == 0){
+			PCON |= 0x01;							// idle until the next intr (Timer2 wakes us every ms,
+			PCON = PCON;							// ..which bounds a wakeup that lands just before this)
+			continue;
 		}
-		// process serial input
-		if(gotcr()){									// wait for a cr ('\r') to be entered
-			z_temp = 0;									// pre-clear "z" flag
-			do{
-				c = getch00();							// skip over leading control chrs
-			}while((c <= ESC) && (c != '\0'));
-			putch(c);
-			switch(c){
-				default:								// invalid command chr
-					do{
-						c = getch00();					// skip to EOL or end of input
-					}while((c != '\r') && (c != '\0'));
-				case '\r':								// empty line
-					break;
-				
-				case 'i':
-					putss("\nresend");					// post prompt
-					PTTreg = ~PTTreg;					// force re-send (simulate a change in the BCD settings)
-					break;
-				
-				case 'E':
-					// "EA" erase all 5 sectors of channel FLASH where the channel data lives	
-					// "E16" erases the last four sectors (CH 16-99).
-					//		tempbyte is TRUE if "E16"
-					tempbyte = FALSE;					// preclear qualifiers
-					tempbyte2 = FALSE;
-					c = getch00();
-					if((c == '1')){
-						c = getch00();
-						if((c == '6')){
-							tempbyte = TRUE;			// erase 16+ enabled
-						}
-					}else{
-						if(c == 'A'){
-							tempbyte2 = TRUE;			// erase all enabled
-						}
-					}
-					if(tempbyte || tempbyte2){				// if valid, execute
-						while(getch00());					// clean out serial buffer
-						if(tempbyte){
-							putss("\nErase CH16+");			// Are you sure? prompt (ch16-end)
-						}else{
-							putss("\nErase All CH");		// Are you sure? prompt (all)
-						}
-						putss(", Press \"Y\" to cont...");	// Are you sure? prompt
-						waittimer = 5000;					// set 5 sec timer
-						while((!anych00()) && (waittimer != 0)); // wait for user input
-						if(getch00() == 'Y'){				// if timeout, getch00 will return '\0' which will abort
-							fptr = (U8 xdata *)SECT00_ADDR;	// set pointer to 1st sector
-							// !!!!! These params are dependent on the size of the allocated channel array !!!!!
-							for(i=0; i<5; i++){				// 100 ch = 5 sectors
-								if((tempbyte && (i > 0)) || (!tempbyte)){
-									erase_flash(fptr);		// erase sector (skip if first sector and tempbyte = true)
-									putch('.');				// display progress
-								}
-								fptr += SECTOR_SIZE;		// set next sector
-							}
-							// !!!!!
-							putss("Erased!\n");				// announce completion
-						}else{
-							putss("Aborted.\n");			// abort msg
-						}
-					}
-					break;
-				
-				case 'e':
-					// echo terminal buffer
-					do{
-						c = getch00();				 		// get byte
-						putch(c);							// echo
-					}while(c != '\r');						// until cr
-					putch('\n');
-					break;
-				
-				case 'Q':
-					// error querry/clear
-					if(loaderr){
-						putss("\nLoad errs\n");
-					}else{
-						putss("\nNO errs\n");
-					}
-					if(gotch00()){
-						if(getch00() == 'C'){
-							putss("Err status cleared\n");
-							loaderr = 0;					// clear error status
-						}
-					}
-					putch('\n');
-					break;
-
-				case 'z':
-					z_temp = 1;										// set "z" cmd flag
-				case 'c':
-					// calc CRC16 on channels
-					temp_crc = 0;
-					rptr = (U8 code *) CHAN_ADDR;
-					for(ii=0; ii<(24 * NUM_CHAN); ii++){
-						temp_crc = calcrc(*rptr++,temp_crc);
-					}
-					if(z_temp){										// do CRC compare if true
-						putss(" CMP CRC16...");
-						j = 1;										// preset PASS
-						if(getbyte(&tempbyte)) j = 0;				// 1st CRC byte -- compare data fail
-						if((U8)(temp_crc >> 8) != tempbyte) j = 0;	// crc fail
-						if(getbyte(&tempbyte)) j = 0;				// 2nd CRC byte -- compare data fail
-						if((U8)(temp_crc & 0xff) != tempbyte) j = 0;	// crc fail
-						wait(1000);									// wait 1 sec
-						if(j){
-							putss("\nPASS\n");
-						}else{
-							loaderr = 1;							// set global fail
-							putss("\nFAIL\n");
-						}
-					}else{
-						putss("\nCRC16 = 0x");						// display calculated CRC
-						put_hex((U8)(temp_crc >> 8));
-						put_hex((U8)(temp_crc & 0xff));
-						putss("\n");
-					}
-					break;
-				
-				case 't':
-				case 'M':
-					// program reg
-					// syntax: Mxxaaaaaaaabbbbbbbbccccccccddddddddeeeeeeeeffffffff
-					// First, validate buffered data (xfr to temp array)
-					k = c;								// save smd chr
-					flag = TRUE;						// default to data good
-					temp_active = 0;					// default to temp = inactive
-					c = getch00();
-					if((c < '0') || (c > '9')){
-						flag = FALSE;
-					}
-					i = (c & 0x0f) << 4;				// ms nyb
-					c = getch00();
-					if((c < '0') || (c > '9')){
-						flag = FALSE;
-					}
-					i |= (c & 0x0f);					// ls nyb
-					pgm_chnum = conv_to_chnum(i);		// convert BCD to hex
-					if(pgm_chnum >= NUM_CHAN){			// max error
-						flag = FALSE;
-					}
-					goteol = 0;
-					i = 0;								// init reg counter
-					while(flag && !goteol){
-						goteol = getbyte(&tempbyte); 	// get byte
-						if(!goteol){
-							temp_chan[i++] = tempbyte;
-						}
-						if(i == MAX_REG){
-							goteol = 1;					// force end if 24 bytes
-						}else{
-							if(goteol) flag = FALSE;	// end of data too soon, error
-						}
-					}
-					// Program data to FLASH
-					if(flag && (k == 'M')){
-						fptr = (U8 xdata *) CHAN_ADDR;	// set pointer to 1st ch
-						fptr += 24 * pgm_chnum;			// jump to ch#
-						for(i=0; i<24; i++){
-							wr_flash(temp_chan[i], fptr++);
-						}
-						putss("CH ");
-						put_dec(pgm_chnum);				// print ch#
-						putss(" pgmd!\n");				// announce completion
-					}else{
-						if(flag){
-							temp_active = 1;			// temp channel active
-							PTTreg = ~PTTreg;
-							putss("Temp reg pgmd\n");	// announce temp reg programmed
-						}else{
-							putss("ERROR!\n");			// announce err
-							loaderr = 1;				// set error
-						}
-					}
-					// Complete
-					break;
+		for(t=0, m=TSK_PORT; !(task_rdy & m); t++, m<<=1);	// find highest priority ready task
+		task_rdy &= ~m;								// ANL direct is atomic wrt the ISRs
+#if (SLICE_CMD == 1)
+		EA = 0;
+		T2_STAMP(ts);
+		EA = 1;
+#endif
+		switch(t){
+			case 0:
+				poll_port();						// process FSEL/PTT changes
+				break;
 
-				case 'P':
-					if(temp_active){
-						flag = TRUE;					// default to data good if temp active
-					}else{
-						flag = FALSE;					// else the whole "P" thing is invalid
-					}
-					c = getch00();						// get & test msd
-					if((c < '0') || (c > '9')){
-						flag = FALSE;
-					}
-					i = (c & 0x0f) << 4;				// convert ms nyb
-					c = getch00();						// get & test lsd
-					if((c < '0') || (c > '9')){
-						flag = FALSE;
-					}
-					i |= (c & 0x0f);					// convert ls nyb
-					pgm_chnum = conv_to_chnum(i);		// convert BCD to hex
-					if(pgm_chnum >= NUM_CHAN){			// check if CH valid
-						flag = FALSE;
-					}
-					// Program temp data to FLASH
-					if(flag){							// only write to FLASH if valid CH and valid temp
-						fptr = (U8 xdata *) CHAN_ADDR;	// set pointer to 1st ch
-						fptr += 24 * pgm_chnum;			// calc index to ch#
-						for(i=0; i<24; i++){			// copy data to FLASH
-							wr_flash(temp_chan[i], fptr++);
-						}
-						putss("CH ");
-						put_dec(pgm_chnum);				// print ch#
-						putss(" pgmd!\n");				// announce completion
-					}else{
-						putss("ERROR!\n");				// announce err
-					}
-					break;
+			case 1:
+				pll_task();							// PLL update complete
+				break;
 
-				case 'r':
-					// read reg
-					// syntax: rxx
-					flag = TRUE;
-					goteol = TRUE;
-					putss("\n");
-					c = getch00();
-					if(c == '-'){
-						i = NUM_CHAN;							// send all chnnels
-						j = 0;
-						pgm_chnum = conv_to_chnum(j);			// convert BCD to hex
-					}else{
-						if(c == 'r'){
-							i = 1;								// send 1 chnnels
-							j = 0;
-							goteol = FALSE;						// select temp channel
-						}else{
-							if((c < '0') || (c > '9')){
-								flag = FALSE;
-							}
-							i = (c & 0x0f) << 4;				// ms nyb
-							c = getch00();
-							if((c < '0') || (c > '9')){
-								flag = FALSE;
-							}
-							i |= (c & 0x0f);					// ls nyb
-							pgm_chnum = conv_to_chnum(i);		// convert BCD to hex
-							if(pgm_chnum >= NUM_CHAN){			// check for max error
-								flag = FALSE;
-							}
-							i = 1;								// just send 1 chan
-							j = pgm_chnum;
-						}
-					}
-					// read data from FLASH
-					if(flag){
-						if(goteol){
-							rptr = (U8 code *) CHAN_ADDR;		// set pointer to 1st ch
-							rptr += 24 * pgm_chnum;				// jump to ch#
-						}
-						do{
-							if(goteol){
-								putch('M');						// pre-amble
-								put_dec(j++);					// print ch#
-								putch(' ');
-							}else{
-								putss("t00 ");					// temp chan preamble
-							}
-							tempbyte = 0;						// use tempbyte to format register fields
-							for(k=0; k<24; k++){
-								if(goteol){
-									put_hex(*rptr++);			// display FLASH data
-								}else{
-									put_hex(temp_chan[k]);		// display temp reg data
-								}
-								if(++tempbyte == 4){
-									putch(' ');					// insert some formatting between 32bit words
-									tempbyte = 0;
-								}
-							}
-							putss("\n");
-						}while(--i != 0);
-					}else{
-						putss("CHerr\n");
-					}
-					break;
-			
-				case 'l':
-				case 'L':
-					// read PLL lock bit
-					// syntax: l, return "1" or "0"
-					if(MISO == PLL_LOCK){
-						putss("1\n");
-					}else{
-						putss("0\n");
-					}
-					break;
+			case 2:
+				cmd_task();							// process serial input
+				break;
 
-				case '?':
-					// Help screen
-					putss("\nOrion Help V1.6\n");
-					putss("Mnna..f: PGM CH nn\t\tt00a..f: temp CH\n");
-					putss("Pnn: PGM temp to CH nn\n");
-					putss("EA: erase all CH\t\tE16: erase CH16-99\n");
-					putss("c: disp CRC16 (0x1021 poly)\tz hhhh: cmp CRC16\n");
-					putss("rnn: read CH nn\t\t\tr-: read all CH\n");
-					putss("rr: read temp CH\t\ti: re-send CH\n");
-					putss("Q: querry errs\t\t\tQC: Clr errs\n");
-					putss("L: read PLL lock stat\t\te: echo cmdln\n");
-					putss("\nMaxValid ch if bcdin = 0xXF\n");			// send help screen
-					break;
-			}
-			cleanline();										// clean up rest of current line
-			putss("\npll>");									// post prompt
+			default:
+				out_task();							// process serial output
+				break;
 		}
+#if (SLICE_CMD == 1)
+		EA = 0;
+		T2_STAMP(te);
+		EA = 1;
+		us = stamp_us(&ts, &te);
+		if(us > task_max[t]) task_max[t] = us;
+#endif
 	}
 }  // end main()
 
 // *********************************************
-//  *************** SUBROUTINES ***************
+//  *************** TASKS ***************
 // *********************************************
 
 //-----------------------------------------------------------------------------
-// send_spi32
+// pll_task() logs the edge to LE time of a completed PLL update
+//-----------------------------------------------------------------------------
+void pll_task(void){
+
+#if (LAT_CMD == 1)
+	if(lat_pend && pll_done){					// PLL update complete, log latency
+		lat_pend = 0;
+		if(le_new){
+			lat_last = stamp_us(&lat_edge, &le_stamp);
+			if(lat_last > lat_max) lat_max = lat_last;
+		}
+	}
+#endif
+	return;
+}
+
+//-----------------------------------------------------------------------------
+// out_task() sends channel dumps and status msgs
 //-----------------------------------------------------------------------------
 //
-// sends 32 bit word to ADS4351 via port4 bit-bang SPI
+// A channel dump ("r") is sent one field (preamble or 32b reg) at a time, while the field
+//	fits in the TX buffer.  rxd_intr wakes this task when the buffer has drained to TXD_WAKE.
+//	Channel status msgs wait until the current cmd is complete.
 //
-void send_spi32(U32 plldata){
-#ifdef BB_SPI
-	U32	mask;
-
-	nPLL_LE = LE_ON;								// latch enab = low to clock in data
-	for(mask = 0x80000000; mask != 0; mask >>= 1){	// start shifting 32 bits starting at MSb
-		if(mask & plldata) MOSI = 1;				// set MOSI
-		else MOSI = 0;
-		delay_halfbit();							// delay half clock
-		SCK = 1;									// clock = high
-		delay_halfbit();							// delay remaining half
-		SCK = 0;									// clock low
+void out_task(void){
+	U8	i;				// temp
+	U8	k;				// temp
+
+#if (XM_CMD == 1)
+	if(cmd_state == CMD_XM){
+		xm_out();								// XMODEM pkt
+		return;
 	}
-	delay_halfbit();								// delay for LE
-	nPLL_LE = LE_OFF;								// latch enab = high to latch data
-	delay_halfbit();								// pad intra-word xfers by a half bit
-	return;	
-	
-#else
-	U8	i;	// loop temps
-	U8	d;
-	union Data32 {	// temp union to parse out 32b word to 8b pieces
-	   U32 l;
-	   U8 b[4];
-	} pllu;  
-
-	pllu.l = plldata;
-	nPLL_LE = LE_ON;								// latch enab = low to clock in data
-	delay_halfbit();								// pad intra-word xfers by a half bit
-	for(i=0; i < 4; i++){							// shifting 32 bits 8 bits at a time
-		d = (U8)(pllu.b[i]);
-		while(SPI0CFG & 0x80);						// wait for buffer to clear
-		SPI0DAT = d;
+#endif
+	if(cmd_state == CMD_DUMP){
+		while(txd_free() >= DUMP_FLD){
+			if(cx_fld == 0){
+				if(cx_flag){
+					putss("t00");					// temp chan preamble
+				}else{
+					if(cx_skip && !chs_valid(cx_idx)){
+						cx_idx++;					// skip empty CH
+						if(--cx_cnt == 0){
+							cmd_done();
+							break;
+						}
+						continue;
+					}
+					putch('M');						// pre-amble
+					put_dec(cx_idx);				// print ch#
+				}
+				if(!cx_terse) putch(' ');
+			}else{
+				k = (cx_fld - 1) << 2;
+				if(!cx_flag) cx_ptr = chs_chan(cx_idx) + k;	// (CH_POOL/CH_FREQ: chs_chan() re-uses its buffer)
+				for(i=0; i<4; i++){
+					if(cx_flag){
+						put_hex(temp_chan[k++]);	// display temp reg data
+					}else{
+						put_hex(*cx_ptr++);			// display FLASH data
+					}
+				}
+				if(!cx_terse) putch(' ');			// insert some formatting between 32bit words
+			}
+			if(++cx_fld == 7){
+				putss("\n");
+				cx_fld = 0;
+				cx_idx++;
+				if(--cx_cnt == 0){
+					cmd_done();
+					break;
+				}
+			}
+		}
+		return;
+	}
+	if((ch_msg != CHMSG_NONE) && (cmd_state == CMD_IDLE) && (txd_free() >= CHMSG_LEN)){ // post channel status
+		k = set_txmode(TXD_TRUNC);				// status msgs don't wait for TX buffer space (it is held
+												// ..until the msg fits, TSK_OUT wakes this task as TX drains)
+		if(ch_msg == CHMSG_TMP){
+			putss("tmp");
+		}else{
+			putss("CH ");
+			put_dec(ch_msg);					// print ch#
+		}
+		ch_msg = CHMSG_NONE;
+		putss("\npll>");						// post prompt
+		set_txmode(k);
 	}
-	while(SPI0CFG & 0x80);							// wait for buffer to clear
-	delay_halfbit();								// pad intra-word xfers by a half bit
-	nPLL_LE = LE_OFF;								// latch enab = low to clock in data
-	delay_halfbit();								// delay for RC pullup on revC CS line
 	return;
-#endif
 }
 
 //-----------------------------------------------------------------------------
-// delay_halfbit
+// cmd_task() processes serial cmds
 //-----------------------------------------------------------------------------
 //
-// sets delay for spi SCK and for CS setup/hold
+// In CMD_IDLE, each slice processes one cmd line.  Cmds that would run long leave a
+//	continuation in cmd_state (and its context in the cx_ vars), and each following
+//	slice does one step of it.  cmd_done() returns to CMD_IDLE.
 //
-	// BitBang version uses for-loop to establish ~~200 us delay
-/*void delay_halfbit(void){
-	U16	i;
-	
-	for(i = 0; i < 500;){							// cheezy for-next-loop to set delay for bit-bang-spi
-													// 500 loops is approx 200us
-		i += 1;
+void cmd_task(void){
+	U8	i;				// loop counter
+	U8	c;				// temp
+
+	if(tmr_done(TMR_BAUD)){								// no valid cmd at the new baud rate
+		set_baud(BAUD_9600);
+		putss("\nbaud 9600\npll>");
 	}
-	return;	
-}*/
-
-#ifdef BB_SPI
-	// BitBangSPI version uses HW timer0 to establish the bit-delay (200us, nominal)
-	// T0 has about 0.5us of delay per timer tic when configured for clock source = SYSCLK/12
-	// define 200us timer delay @24.5MHz/12 timer clock = (65536 - (400*0.5us))
-#define	T0_VALUE	65136
-#else
-	// HWSPI version uses HW timer0 to establish quick delay (8us, nominal)
-	// T0 has about 0.5us of delay per timer tic when configured for clock source = SYSCLK/12
-	// define 8us timer delay @24.5MHz/12 timer clock = (65536 - (16*0.5us))
-#define	T0_VALUE	0xFFF0
-#endif
+	switch(cmd_state){
+		case CMD_IDLE:
+			if(gotcr()){									// wait for a cr ('\r') to be entered
+				do_cmd();
+				task_rdy |= TSK_CMD;						// check for another cmd line
+			}
+			break;
 
-void delay_halfbit(void){							// for HWSPI, this fnd is just used to set reg-reg xfr delay
+		case CMD_ERCONF:
+			// erase: wait for "Y" (any other chr, or timeout, aborts)
+			if(anych00()){
+				if(getch00() == 'Y'){
+					tmr_stop(TMR_CMD);
+					cmd_state = CMD_ERASE;
+					task_rdy |= TSK_CMD;
+					break;
+				}
+			}else{
+				if(!tmr_done(TMR_CMD)) break;
+			}
+			putss("Aborted.\n");							// abort msg
+			cmd_done();
+			break;
 
-	TH0 = (T0_VALUE >> 8);							// prep timer registers for delay
-	TL0 = (T0_VALUE & 0xFF);
-	TF0 = 0;
-	TR0 = 1;										// start timer
-	while(TF0 == 0);								// loop
-	TR0 = 0;										// stop timer
-	return;	
-}
+		case CMD_ERASE:
+#if !CHS_FLAT
+			// CH_LOG/CH_POOL/CH_FREQ: "E16"/"Exx-yy" write a blank CH for each CH cx_idx thru cx_cnt (one per
+			//	slice), "EA" erases the CH sectors (one per slice) and starts over
+			if(cx_flag){
+				if(cx_idx <= cx_cnt){
+					temp_active = 0;						// temp_chan[] is the blank CH
+					for(i=0; i<MAX_REG; i++){
+						temp_chan[i] = 0xff;
+					}
+					chs_wrchan(cx_idx++, temp_chan);
+					task_rdy |= TSK_CMD;
+					break;
+				}
+			}else{
+				if(cx_idx < NUM_SECT){
+					chs_erase(cx_idx++);
+					putch('.');								// display progress
+					task_rdy |= TSK_CMD;
+					break;
+				}
+				chs_init();
+			}
+			putss("Erased!\n");
+			cmd_done();
+			break;
+#else
+			// erase sector cx_idx thru cx_cnt, one per slice (the CPU stalls for the sector erase time)
+			chs_hold(1);									// save the table CRC once, at the end
+			chs_erase(cx_idx);
+			putch('.');										// display progress
+			if(cx_idx++ == cx_cnt){
+				chs_hold(0);
+				putss("Erased!\n");							// announce completion
+				cmd_done();
+			}else{
+				task_rdy |= TSK_CMD;
+			}
+			break;
+#endif
 
-//-----------------------------------------------------------------------------
-// calcrc() calculates incremental crcsum using defined poly
-//	(xmodem poly = 0x1021)
-//-----------------------------------------------------------------------------
-U16 calcrc(U8 c, U16 oldcrc){
-#define	POLY 0x1021	// xmodem polynomial
+#if (CRCQ_CMD == 1)
+		case CMD_CRC:
+			// CRC query: each sector (cx_flag), or a CH range (one CH per slice)
+#if CHS_FLAT
+			if(cx_flag){
+				for(i=0; (i<CRC_SLICE) && (cx_len!=0); i++, cx_len--){
+					cx_crc = calcrc(*cx_ptr++, cx_crc);
+				}
+				if(cx_len != 0){
+					task_rdy |= TSK_CMD;					// more to do
+					break;
+				}
+				putch('S');									// "Sn hhhh"
+				put_dec(cx_idx);
+				putch(' ');
+				put_hex((U8)(cx_crc >> 8));
+				put_hex((U8)(cx_crc & 0xff));
+				putch('\n');
+				if(++cx_idx < NUM_SECT){
+					crc_sect(cx_idx);
+					task_rdy |= TSK_CMD;
+					break;
+				}
+			}else
+#endif
+			{
+				cx_ptr = chs_chan(cx_idx++);
+				for(i=0; i<MAX_REG; i++){
+					cx_crc = calcrc(*cx_ptr++, cx_crc);
+				}
+				if(--cx_cnt != 0){
+					task_rdy |= TSK_CMD;					// more to do
+					break;
+				}
+				put_crc(cx_crc);
+			}
+			cmd_done();
+			break;
+#endif
 
-	U16 crc;
-	U8	i;
-	
-	crc = oldcrc ^ ((U16)c << 8);
-	for (i = 0; i < 8; ++i){
-		if (crc & 0x8000) crc = (crc << 1) ^ POLY; //0x1021;
-		else crc = crc << 1;
-	 }
-	 return crc;
-}
+#if (BULK_CMD == 1)
+		case CMD_BULK:
+			// bulk upload: program one record per slice.  rxd_intr holds the host off (XOFF)
+			//	if rxd_buff fills while the FLASH is written.
+			if(rxd_crpend()){
+				i = bulk_rec();
+				if(i < NUM_CHAN){
+					c = chs_wrchan(i, temp_chan);			// verify
+					if(c == 0){
+						cx_cnt++;
+					}else{
+						i = BULK_ERR;
+					}
+				}
+				if(i == BULK_ERR){
+					if(cx_err != 0xFF) cx_err++;
+					loaderr = 1;							// set error
+				}
+				if(i != BULK_END){
+					tmr_start(TMR_CMD, BULK_TMO, 0);
+					task_rdy |= TSK_CMD;					// there may be another record
+					break;
+				}
+			}else{
+				if(!tmr_done(TMR_CMD)) break;
+			}
+			// done, report w/ the summary CRC
+			tmr_stop(TMR_CMD);
+			set_flow(0);
+			chs_hold(0);
+			putss("\nbulk: ");
+			put_dec16(cx_cnt);
+			putss(" pgmd, ");
+			put_dec16(cx_err);
+			putss(" errs");
+			put_crc(chs_crc());
+			cmd_done();
+			break;
+#endif
 
-//-----------------------------------------------------------------------------
-// wait() uses ms timer to establish a defined delay
-//-----------------------------------------------------------------------------
+#if (XM_CMD == 1)
+		case CMD_XM:
+			i = xm_poll();
+			if(i == XM_BUSY) break;
+			if(i == XM_DONE){
+				putss("\nXMODEM ok\n");
+			}else{
+				loaderr = 1;								// set error
+				putss("\nXMODEM fail\n");
+			}
+			cmd_done();
+			break;
+#endif
 
-void wait(U16 waitms)
-{
+#if (BIN_CMD == 1)
+		case CMD_BIN:
+			bin_cmd();
+			break;
+#endif
 
-    waittimer = waitms/MS_PER_TIC;
-	if(waittimer == 0) waittimer = 1;
-    while(waittimer != 0);
+		default:
+			break;											// CMD_DUMP: see out_task()
+	}
+	return;
 }
 
 //-----------------------------------------------------------------------------
-// put_hex
+// cmd_done() ends the current cmd and posts the prompt
 //-----------------------------------------------------------------------------
-//
-// sends 8b hex to serial port as ASCII
-//
-void put_hex(U8 dhex){
-	char	c;
-	
-	c = (dhex >> 4) + '0';
-	if(c > '9') c += 'A' - '9' - 1;
-	putch(c);
-	c = (dhex & 0x0f) + '0';
-	if(c > '9') c += 'A' - '9' - 1;
-	putch(c);
+void cmd_done(void){
+
+	cmd_state = CMD_IDLE;
+	in_cmd = 0;
+	putss("\npll>");										// post prompt
+	task_rdy |= TSK_CMD | TSK_OUT;							// next cmd line, deferred status msg
 	return;
 }
 
+#if (BIN_CMD == 1)
 //-----------------------------------------------------------------------------
-// put_dec
+// bin_cmd() processes one binary cmd frame (see frame.h), and sends one response frame
 //-----------------------------------------------------------------------------
-//
-// sends 8b hex to serial port as decimal ASCII
-//
-void put_dec(U8 dhex){
-	U8		d;		// bcd temp
-	U8 		i;		// temps
-	U8 		j;
+void bin_cmd(void){
+	U8	i;				// temp
+	U8	st;				// response status
+	U8 CHS_MEM * rptr;	// CH data pointer
+	U16	crc;			// OP_CRC/OP_SCRC result
 
-	if(dhex > 99){
-		putss(">>");
-	}else{
-		j = dhex / 10;
-		i = dhex - (j * 10);
+	i = fr_rx();
+	if(i == FR_NONE) return;
+	task_rdy |= TSK_CMD;							// there may be another frame
+	if(i == FR_BAD){
+		fr_done();
+		fr_start(fr_seq, fr_op, ST_CRC);
+		fr_send();
+		return;
+	}
+	st = ST_OK;
+	switch(fr_op){
+		case OP_SEL:
+		case OP_READ:
+		case OP_PGM:
+			if(fr_len != ((fr_op == OP_PGM) ? (1 + MAX_REG) : 1)){
+				st = ST_OP;
+				break;
+			}
+			if(fr_arg >= NUM_CHAN){
+				st = ST_ARG;
+				break;
+			}
+			rptr = chs_chan(fr_arg);
+			if(fr_op == OP_SEL){
+				for(i=0; i<MAX_REG; i++){
+					temp_chan[i] = *rptr++;				// select CH as the temp channel
+				}
+				temp_active = 1;
+				PTTreg = ~PTTreg;						// force re-send
+				task_rdy |= TSK_PORT;
+			}
+			if(fr_op == OP_PGM){
+				temp_active = 0;						// temp_chan[] is the staging buffer
+				for(i=0; i<MAX_REG; i++){
+					temp_chan[i] = fr_byte();
+				}
+				if(chs_wrchan(fr_arg, temp_chan)){		// (re-writes a pgmd CH)
+					st = ST_FLASH;
+					loaderr = 1;						// set error
+				}
+			}
+			break;
+
+#if CHS_FLAT
+		case OP_ERASE:
+			if(fr_len != 1){
+				st = ST_OP;
+			}else{
+				if(fr_arg >= NUM_SECT){
+					st = ST_ARG;
+				}else{
+					chs_erase(fr_arg);
+				}
+			}
+			break;
+
+		case OP_CRC:
+			// the CRC is done here, in one slice (like OP_ERASE, the host waits for the rsp)
+			if(fr_len != 2){
+				st = ST_OP;
+			}else{
+				i = fr_byte();							// # ch
+				if((fr_arg >= NUM_CHAN) || (i == 0) || (i > (NUM_CHAN - fr_arg))){
+					st = ST_ARG;
+				}else{
+					crc = chs_crcrange(24 * (U16)fr_arg, 24 * (U16)i);
+				}
+			}
+			break;
+
+		case OP_SCRC:
+			if(fr_len != 1){
+				st = ST_OP;
+			}else{
+				if(fr_arg >= NUM_SECT){
+					st = ST_ARG;
+				}else{
+					crc = chs_crcrange(chs_sectoff(fr_arg), chs_sectoff(fr_arg + 1) - chs_sectoff(fr_arg));
+				}
+			}
+			break;
+#endif
+
+		case OP_LOCK:
+		case OP_STAT:
+		case OP_HUMAN:
+			if(fr_len != 0) st = ST_OP;
+			break;
+
+		default:
+			st = ST_OP;
+			break;
+	}
+	fr_done();
+	fr_start(fr_seq, fr_op, st);
+	if(st == ST_OK){
+		switch(fr_op){
+			case OP_READ:
+				// re-fetched per byte (as xm_out does): fr_put() can poll the port, and a CH
+				//	change re-uses the chs_chan() buffer (CH_POOL/CH_FREQ)
+				for(i=0; i<MAX_REG; i++){
+					fr_put(chs_chan(fr_arg)[i]);
+				}
+				break;
+
+			case OP_LOCK:
+				fr_put(pll_lock());
+				break;
+
+			case OP_CRC:
+			case OP_SCRC:
+				fr_put((U8)(crc >> 8));
+				fr_put((U8)(crc & 0xff));
+				break;
+
+			case OP_STAT:
+				fr_put(loaderr);
+				fr_put((U8)(preempt_cnt >> 8));
+				fr_put((U8)(preempt_cnt & 0xff));
+#if (LAT_CMD == 1)
+				fr_put((U8)(lat_last >> 8));
+				fr_put((U8)(lat_last & 0xff));
+				fr_put((U8)(lat_max >> 8));
+				fr_put((U8)(lat_max & 0xff));
+#else
+				for(i=0; i<4; i++){
+					fr_put(0);							// (no edge to LE times)
+				}
+#endif
+				break;
+		}
+	}
+	fr_send();
+	if((st == ST_OK) && (fr_op == OP_HUMAN)){
+		set_rawrx(0);
+		cmd_done();
+	}
+	return;
+}
+#endif
+
+#if (BULK_CMD == 1)
+//-----------------------------------------------------------------------------
+// bulk_rec() parses one bulk upload line into temp_chan[].  The line (and its CR) is
+//	always consumed.
+//	Record syntax is the same as the "M" cmd: Mnnaaaaaaaabbbbbbbbccccccccddddddddeeeeeeeeffffffff
+//	returns ch#, BULK_NONE (empty line), BULK_END ("."), or BULK_ERR
+//-----------------------------------------------------------------------------
+U8 bulk_rec(void){
+	U8	c;				// temp chr
+	U8	d;				// temp nybble
+	U8	n;				// # nybbles
+	U8	chnum;			// ch#
+	bit	err;			// record error
+
+	do{
+		c = getch00();							// skip over leading control chrs and spaces
+	}while((c <= ' ') && (c != '\r') && (c != '\0'));
+	if(c == '\r') return BULK_NONE;
+	err = (c != 'M');
+	chnum = 0;
+	n = 0;
+	d = c;
+	while((c != '\r') && (c != '\0')){
+		c = getch00();
+		if((c == '\r') || (c == '\0') || whitespc(c)) continue;
+		d = convnyb(c);
+		if(n < 2){
+			if(d > 9) err = 1;					// ch# is 2 decimal digits
+			chnum = (chnum * 10) + d;
+		}else{
+			if((d > 0x0f) || (n >= (2 + (2 * MAX_REG)))){
+				err = 1;						// bad hex or too long
+			}else{
+				if(n & 0x01){
+					temp_chan[(n - 2) >> 1] |= d;
+				}else{
+					temp_chan[(n - 2) >> 1] = d << 4;
+				}
+			}
+		}
+		n++;
+	}
+	if((n == 0) && (d == '.')) return BULK_END;
+	if(err || (n != (2 + (2 * MAX_REG))) || (chnum >= NUM_CHAN)) return BULK_ERR;
+	return chnum;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// do_cmd() processes one cmd line
+//-----------------------------------------------------------------------------
+void do_cmd(void){
+	char c;				// temp term chr
+	U8	i;				// loop counter
+	U8	j;				// loop counter
+	U8	k;				// loop counter
+	bit	flag;			// temp flag
+	bit	goteol;			// temp flag
+	U8	pgm_chnum;		// prog chan temp
+	U8	tempbyte;		// prog byte temp
+	bit	cmd_ok;			// valid cmd (confirms a new baud rate)
+	U32	f;				// "F" frequency, "K" ppm, "O" AND mask, "z" CRC
+	U32	spc;			// "F" spacing, "O" OR mask
+	S16	ppm;			// "K" ppm
+#if (SLICE_CMD == 1)
+	TSTAMP	ts;			// "SR" start
+	TSTAMP	te;			// "SR" end
+#endif
+
+	in_cmd = 1;									// PLL updates from here on are preemptions
+	do{
+		c = getch00();							// skip over leading control chrs
+	}while((c <= ESC) && (c != '\0'));
+	putch(c);
+	cmd_ok = 1;
+	switch(c){
+		default:								// invalid command chr
+			do{
+				c = getch00();					// skip to EOL or end of input
+			}while((c != '\r') && (c != '\0'));
+		case '\r':								// empty line
+			cmd_ok = 0;
+			break;
+
+		case 'B':
+			// set baud rate
+			// syntax: Bn, n = 0-3 (9600, 19200, 57600, 115200).  Reverts to 9600 if a valid cmd
+			//	is not received at the new rate within BAUD_TMO.
+			cmd_ok = 0;
+			i = getch00() - '0';
+			if(i < NUM_BAUD){
+				putss("\nbaud ");
+				put_dec16(baud100[i]);
+				putss("00\n");
+				set_baud(i);
+				if(i == BAUD_9600){
+					tmr_stop(TMR_BAUD);
+				}else{
+					tmr_start(TMR_BAUD, BAUD_TMO, 0);
+				}
+			}else{
+				putss("\nbaud err\n");
+			}
+			break;
+		
+		case 'i':
+			putss("\nresend");					// post prompt
+			PTTreg = ~PTTreg;					// force re-send (simulate a change in the BCD settings)
+			pll_invalidate();					// ..of every register, not just the changes
+			task_rdy |= TSK_PORT;
+			break;
+		
+		case 'E':
+			// "EA" erase the sectors of channel FLASH where the channel data lives (NUM_SECT)
+			// "E16" erases CH 16 thru the last CH (CH16 starts sector 1, see chstore.c)
+			// "Exx-yy" erases the sectors that hold CH xx thru yy
+			c = rxd_peek(0);
+			j = NUM_CHAN - 1;					// default to the last CH
+			if(c == 'A'){
+				getch00();
+				i = 0;							// erase all
+			}else{
+				i = get_chnum();
+				if(rxd_peek(0) == '-'){
+					getch00();
+					j = get_chnum();
+				}else{
+					if(i != 16) i = CH_BAD;		// only E16 may leave out the last CH
+				}
+				if((j == CH_BAD) || (j < i)) i = CH_BAD;
+			}
+			if(i != CH_BAD){						// if valid, execute
+				while(getch00());					// clean out serial buffer
+#if !CHS_FLAT
+				cx_flag = (c != 'A');				// blank CH i thru j (else erase the CH sectors)
+				cx_idx = i;
+				cx_cnt = j;
+				if(!cx_flag) cx_idx = 0;			// start at 1st sector
+#else
+				cx_idx = CH_SECT(24 * (U16)i);		// 1st sector
+				cx_cnt = CH_SECT(24 * (U16)j + 23);	// last sector
+				i = chs_sectoff(cx_idx) / 24;		// the CHs in those sectors
+				j = (chs_sectoff(cx_cnt + 1) - 1) / 24;
+#endif
+				if(c == 'A'){
+					putss("\nErase All CH");		// Are you sure? prompt (all)
+				}else{
+					putss("\nErase CH");			// Are you sure? prompt (range)
+					put_dec(i);
+					putch('-');
+					put_dec(j);
+				}
+				putss(", Press \"Y\" to cont...");	// Are you sure? prompt
+				cmd_state = CMD_ERCONF;				// cmd_task() waits for the reply..
+				tmr_start(TMR_CMD, MS5000, 0);		// ..for up to 5 sec
+			}
+			break;
+		
+		case 'e':
+			// echo terminal buffer
+			do{
+				c = getch00();				 		// get byte
+				putch(c);							// echo
+			}while(c != '\r');						// until cr
+			putch('\n');
+			break;
+		
+		case 'Q':
+			// error querry/clear
+			if(loaderr){
+				putss("\nLoad errs\n");
+			}else{
+				putss("\nNO errs\n");
+			}
+			putss("Preempt 0x");				// # PLL updates made during a serial cmd
+			put_hex((U8)(preempt_cnt >> 8));
+			put_hex((U8)(preempt_cnt & 0xff));
+			putch('\n');
+			if(rxd_ovf(0)){
+				putss("RX ovf\n");				// rxd_buff overflow
+			}
+			if(gotch00()){
+				if(getch00() == 'C'){
+					putss("Err status cleared\n");
+					loaderr = 0;					// clear error status
+					preempt_cnt = 0;
+					rxd_ovf(1);
+				}
+			}
+			putch('\n');
+			break;
+
+		case 'z':
+		case 'c':
+			// CRC16 on channels (kept current by chstore.c)
+			if(c == 'z'){									// get CRC to compare
+				putss(" CMP CRC16...");
+				flag = 1;									// preset data good
+				if(getbyte(&tempbyte)) flag = 0;			// 1st CRC byte -- compare data fail
+				f = (U16)tempbyte << 8;
+				if(getbyte(&tempbyte)) flag = 0;			// 2nd CRC byte -- compare data fail
+				f |= tempbyte;
+				if(flag && (chs_crc() == (U16)f)){			// (the kept CRC is current, no delay needed)
+					putss("\nPASS\n");
+				}else{
+					loaderr = 1;							// set global fail
+					putss("\nFAIL\n");
+				}
+			}else{
+				put_crc(chs_crc());
+			}
+			break;
+		
+#if (CRCQ_CMD == 1)
+		case 'C':
+			// CRC16 query for differential sync
+			// syntax: C (each sector), Cnn (CH nn), or Cnn-mm (CH nn thru mm)
+			c = rxd_peek(0);
+#if !CHS_FLAT
+			if((c == '\r') || (c == '\0')){				// CH_LOG/CH_POOL/CH_FREQ: no CH sectors, do all CH
+				cx_flag = 0;
+				cx_idx = 0;
+				cx_cnt = NUM_CHAN;
+				cx_crc = 0;
+			}else{
+#else
+			if((c == '\r') || (c == '\0')){
+				cx_flag = 1;								// sector list
+				cx_idx = 0;
+				crc_sect(0);
+				putch('\n');
+			}else{
+#endif
+				cx_flag = 0;
+				i = get_chnum();
+				j = i;
+				if(rxd_peek(0) == '-'){
+					getch00();
+					j = get_chnum();
+				}
+				if((i == CH_BAD) || (j == CH_BAD) || (j < i)){
+					putss("CHerr\n");
+					break;
+				}
+				cx_idx = i;
+				cx_cnt = j - i + 1;
+				cx_crc = 0;
+			}
+			cmd_state = CMD_CRC;
+			task_rdy |= TSK_CMD;
+			break;
+#endif
+
+#if (BULK_CMD == 1)
+		case 'U':
+			// bulk upload
+			// syntax: U, then a stream of "M" lines (no prompts), then "."
+			//	Pgmd channels are re-written (slow, see chs_wrchan()).  The host must honor XON/XOFF.
+			putss("\nbulk upload, end w/ \".\"\n");
+			temp_active = 0;						// temp_chan[] is the record buffer
+			cx_cnt = 0;
+			cx_err = 0;
+			chs_hold(1);							// save the table CRC at the end
+			cmd_state = CMD_BULK;
+			tmr_start(TMR_CMD, BULK_TMO, 0);
+			set_flow(1);
+			break;
+#endif
+
+#if (XM_CMD == 1)
+		case 'X':
+			// XMODEM-CRC transfer of the channel image
+			// syntax: XR (receive into erased channels), XS (send)
+			c = getch00();
+			if((c == 'R') || (c == 'S')){
+				putss("\nXMODEM ");
+				if(c == 'R'){
+#if !CHS_FLAT
+					putss("rcv: n/a (CH fmt)\n");		// no flat image to receive into
+					break;
+#else
+					putss("rcv\n");
+					if(xm_start(XM_RX)){
+						putss("CHs not erased\n");		// (EA first)
+						break;
+					}
+#endif
+				}else{
+					putss("send\n");
+					xm_start(XM_TX);
+				}
+				cmd_state = CMD_XM;
+			}else{
+				putss("\nXR or XS\n");
+			}
+			break;
+#endif
+
+#if (BIN_CMD == 1)
+		case '#':
+			// binary framed cmd mode (see frame.h).  OP_HUMAN returns to the cmd line.
+			putss("\nbinary mode\n");
+			temp_active = 0;
+			set_rawrx(1);
+			cmd_state = CMD_BIN;
+			break;
+#endif
+
+		case 't':
+		case 'M':
+			// program reg
+			// syntax: Mxxaaaaaaaabbbbbbbbccccccccddddddddeeeeeeeeffffffff
+			// First, validate buffered data (xfr to temp array)
+			k = c;								// save smd chr
+			flag = TRUE;						// default to data good
+			temp_active = 0;					// default to temp = inactive
+			c = getch00();
+			if((c < '0') || (c > '9')){
+				flag = FALSE;
+			}
+			i = (c & 0x0f) << 4;				// ms nyb
+			c = getch00();
+			if((c < '0') || (c > '9')){
+				flag = FALSE;
+			}
+			i |= (c & 0x0f);					// ls nyb
+			pgm_chnum = conv_to_chnum(i);		// convert BCD to hex
+			if(pgm_chnum >= NUM_CHAN){			// max error
+				flag = FALSE;
+			}
+			goteol = 0;
+			i = 0;								// init reg counter
+			while(flag && !goteol){
+				goteol = getbyte(&tempbyte); 	// get byte
+				if(!goteol){
+					temp_chan[i++] = tempbyte;
+				}
+				if(i == MAX_REG){
+					goteol = 1;					// force end if 24 bytes
+				}else{
+					if(goteol) flag = FALSE;	// end of data too soon, error
+				}
+			}
+			// Program data to FLASH
+			if(flag && (k == 'M')){
+				if(chs_wrchan(pgm_chnum, temp_chan)){
+					loaderr = 1;				// FLASH verify err
+				}
+				putss("CH ");
+				put_dec(pgm_chnum);				// print ch#
+				putss(" pgmd!\n");				// announce completion
+			}else{
+				if(flag){
+					temp_active = 1;			// temp channel active
+					PTTreg = ~PTTreg;
+					task_rdy |= TSK_PORT;
+					putss("Temp reg pgmd\n");	// announce temp reg programmed
+				}else{
+					putss("ERROR!\n");			// announce err
+					loaderr = 1;				// set error
+				}
+			}
+			// Complete
+			break;
+
+		case 'P':
+			if(temp_active){
+				flag = TRUE;					// default to data good if temp active
+			}else{
+				flag = FALSE;					// else the whole "P" thing is invalid
+			}
+			c = getch00();						// get & test msd
+			if((c < '0') || (c > '9')){
+				flag = FALSE;
+			}
+			i = (c & 0x0f) << 4;				// convert ms nyb
+			c = getch00();						// get & test lsd
+			if((c < '0') || (c > '9')){
+				flag = FALSE;
+			}
+			i |= (c & 0x0f);					// convert ls nyb
+			pgm_chnum = conv_to_chnum(i);		// convert BCD to hex
+			if(pgm_chnum >= NUM_CHAN){			// check if CH valid
+				flag = FALSE;
+			}
+			// Program temp data to FLASH
+			if(flag){							// only write to FLASH if valid CH and valid temp
+				if(chs_wrchan(pgm_chnum, temp_chan)){	// re-writes the CH's sector(s) if needed
+					loaderr = 1;				// FLASH verify err
+				}
+				putss("CH ");
+				put_dec(pgm_chnum);				// print ch#
+				putss(" pgmd!\n");				// announce completion
+			}else{
+				putss("ERROR!\n");				// announce err
+			}
+			break;
+
+		case 'r':
+			// read reg
+			// syntax: rxx, rxx-yy, r-, or rr, then options: v (skip empty CH), t (terse)
+			flag = TRUE;
+			goteol = TRUE;
+			putss("\n");
+			c = rxd_peek(0);
+			if(c == '-'){
+				getch00();
+				i = NUM_CHAN;							// send all chnnels
+				j = 0;
+			}else{
+				if(c == 'r'){
+					getch00();
+					i = 1;								// send 1 chnnels
+					j = 0;
+					goteol = FALSE;						// select temp channel
+				}else{
+					j = get_chnum();					// 1st chan
+					i = j;
+					if(rxd_peek(0) == '-'){
+						getch00();
+						i = get_chnum();				// last chan
+					}
+					if((i == CH_BAD) || (j == CH_BAD) || (i < j)){
+						flag = FALSE;
+					}
+					i = i - j + 1;						// # chan to send
+				}
+			}
+			cx_skip = 0;
+			cx_terse = 0;
+			do{
+				c = rxd_peek(0);
+				if(c == 'v'){
+					cx_skip = 1;						// skip empty CH
+					getch00();
+				}
+				if(c == 't'){
+					cx_terse = 1;						// no spaces
+					getch00();
+				}
+			}while((c == 'v') || (c == 't'));
+			// read data from FLASH (out_task() sends the channels as TX buffer space allows)
+			if(flag){
+				cx_flag = !goteol;						// temp chan
+				cx_cnt = i;
+				cx_idx = j;
+				cx_fld = 0;
+				cmd_state = CMD_DUMP;
+				task_rdy |= TSK_OUT;
+			}else{
+				putss("CHerr\n");
+			}
+			break;
+	
+#if (SYN_CMD == 1)
+		case 'F':
+			// synthesize the temp channel regs for a frequency (10 Hz units)
+			// syntax: F fff.fffff [p [sss.ss]] (MHz, power 0-3 (+4 MTLD, +8 PD), spacing KHz)
+			f = get_dec(5);
+			i = SYN_PWR;
+			spc = SYN_SPC;
+			flag = TRUE;
+			while(whitespc(rxd_peek(0))) getch00();
+			c = rxd_peek(0);
+			if((c >= '0') && (c <= '9')){
+				spc = get_dec(0);						// power/flags
+				if(spc > 15) flag = FALSE;
+				i = (U8)spc;
+				spc = SYN_SPC;
+				c = rxd_peek(0);
+				if(whitespc(c)){
+					spc = get_dec(2);
+					if(spc == 0) spc = SYN_SPC;
+				}else{
+					if((c != '\r') && (c != '\0')) flag = FALSE;	// "p" runs into the spacing
+				}
+			}
+			if(flag && (f != 0) && (f != DEC_BAD) && (spc != DEC_BAD) && (syn_calc(f, spc, i, (U32 idata *)temp_chan) == SYN_OK)){
+				temp_active = 1;						// temp channel active
+				PTTreg = ~PTTreg;
+				task_rdy |= TSK_PORT;
+				putss("\nTemp reg pgmd\n");				// announce temp reg programmed
+			}else{
+				putss("\nFerr\n");
+			}
+			break;
+#endif
+
+#if (CFG_CMD == 1)
+		case 'K':
+			// ref ppm correction
+			// syntax: K [+/-ppp.pp] (0.01 ppm, |ppm| <= PPM_MAX)
+			while(whitespc(rxd_peek(0))) getch00();
+			c = rxd_peek(0);
+			i = (c == '-');
+			if((c == '-') || (c == '+')) getch00();
+			c = rxd_peek(0);
+			if(((c >= '0') && (c <= '9')) || (c == '.')){
+				f = get_dec(2);
+				if(f > PPM_MAX){
+					putss("\nKerr\n");
+					break;
+				}
+				pll_cfg.ppm = i ? -(S16)f : (S16)f;
+				if(chs_savecfg((U8 idata *)&pll_cfg)){
+					putss("\nKerr\n");
+				}
+				PTTreg = ~PTTreg;						// re-send w/ the new correction
+				task_rdy |= TSK_PORT;
+			}
+			putss("\nppm: ");
+			ppm = pll_cfg.ppm;
+			if(ppm < 0){
+				putch('-');
+				ppm = -ppm;
+			}
+			put_dec16((U16)ppm / 100);
+			putch('.');
+			put_dec((U8)((U16)ppm % 100));
+			putch('\n');
+			break;
+
+		case 'O':
+			// reg overlays
+			// syntax: O (list), On aaaaaaaa oooooooo (Rn = (Rn & a) | o), On (clear Rn), OC (clear all),
+			//	OW (save)
+			c = rxd_peek(0);
+			if((c >= '0') && (c <= '5')){
+				j = getch00() & 0x0f;					// reg#
+				while(whitespc(rxd_peek(0))) getch00();
+				c = rxd_peek(0);
+				f = 0xffffffffL;						// (no masks: clear)
+				spc = 0;
+				if((c > ESC) && (c != '\0')){
+					f = 0;
+					for(k=0; k<8; k++){
+						if(getbyte(&tempbyte)) break;
+						if(k < 4) f = (f << 8) | tempbyte;
+						else spc = (spc << 8) | tempbyte;
+					}
+					if(k != 8){
+						putss("\nOerr\n");
+						break;
+					}
+				}
+				if(pll_setovl(j, f, spc)){
+					putss("\nOerr\n");
+					break;
+				}
+				PTTreg = ~PTTreg;						// re-send w/ the new overlay
+				task_rdy |= TSK_PORT;
+			}else if((c == 'C') || (c == 'c')){		// (c is the mask chr after On)
+				getch00();
+				for(j=0; j<NUM_REG; j++){
+					pll_setovl(j, 0xffffffffL, 0);
+				}
+				PTTreg = ~PTTreg;
+				task_rdy |= TSK_PORT;
+			}else if((c == 'W') || (c == 'w')){
+				getch00();
+				if(chs_savecfg((U8 idata *)&pll_cfg)){
+					putss("\nOerr\n");
+					break;
+				}
+			}
+			putch('\n');
+			for(i=0; i<OVL_NUM; i++){
+				if(pll_cfg.oreg[i] != OVL_NONE){
+					putch('R');
+					putch(pll_cfg.oreg[i] + '0');
+					putss(" & ");
+					put_hex32(pll_cfg.oand[i]);
+					putss(" | ");
+					put_hex32(pll_cfg.oor[i]);
+					putch('\n');
+				}
+			}
+			break;
+#endif
+
+		case 'l':
+		case 'L':
+			// read PLL lock bit
+			// syntax: l, return "1" or "0"
+			if(pll_lock()){
+				putss("1\n");
+			}else{
+				putss("0\n");
+			}
+			break;
+
+#if (LAT_CMD == 1)
+		case 'T':
+			// port edge to LE time
+			// syntax: T, or TC to clear max
+			putss("\nedge-LE us: ");
+			put_dec16(lat_last);
+			putss(", max ");
+			put_dec16(lat_max);
+			putch('\n');
+			if(getch00() == 'C'){
+				lat_max = 0;
+			}
+			break;
+#endif
+
+#if (SLICE_CMD == 1)
+		case 'S':
+			// task slice times (us, port/pll/cmd/out)
+			// syntax: S, or SC to clear.  SR times a CRC16 of the CH table (compare CRC_TBL builds)
+			c = getch00();
+			if(c == 'R'){
+				EA = 0;
+				T2_STAMP(ts);
+				EA = 1;
+				f = chs_crcrange(0, 24 * NUM_CHAN);
+				EA = 0;
+				T2_STAMP(te);
+				EA = 1;
+				putss("\ncrc us: ");
+				put_dec16(stamp_us(&ts, &te));
+				put_crc((U16)f);
+				break;
+			}
+			putss("\nslice us:");
+			for(i=0; i<NUM_TASK; i++){
+				putch(' ');
+				put_dec16(task_max[i]);
+			}
+			putch('\n');
+			if(c == 'C'){
+				for(i=0; i<NUM_TASK; i++){
+					task_max[i] = 0;
+				}
+			}
+			break;
+#endif
+
+		case '?':
+			// Help screen
+			putss("\nOrion Help V1.7\n");
+			putss("Mnna..f: PGM CH nn\t\tt00a..f: temp CH\n");
+			putss("Pnn: PGM temp to CH nn\t\t(M/P re-write a pgmd CH)\n");
+			putss("EA: erase all CH\t\tE16: erase CH16-99\n");
+			putss("Enn-mm: erase the sectors of CH nn-mm\n");
+			putss("c: disp CRC16 (0x1021 poly)\tz hhhh: cmp CRC16\n");
+#if (CRCQ_CMD == 1)
+			putss("C: CRC16 of each sector\tCnn[-mm]: CRC16 of CH nn[-mm]\n");
+#endif
+#if (SYN_CMD == 1)
+			putss("F fff.fffff [p [sss.ss]]: temp CH = fff.fffff MHz, pwr p, spacing sss.ss KHz\n");
+#endif
+#if (CFG_CMD == 1)
+			putss("K [+/-ppp.pp]: ref correction, ppm (K: disp).  Res: 1/(8190*N) worst case\n");
+			putss("On aaaaaaaa oooooooo: Rn = (Rn & a) | o\t(On: clr, OC: clr all, O: disp, OW: save)\n");
+#endif
+			putss("rnn: read CH nn\t\t\tr-: read all CH\n");
+			putss("rnn-mm: read CH nn-mm\t\t(r..v: skip empty, r..t: terse)\n");
+			putss("rr: read temp CH\t\ti: re-send CH\n");
+			putss("Q: querry errs\t\t\tQC: Clr errs\n");
+			putss("L: read PLL lock stat\t\te: echo cmdln\n");
+#if (LAT_CMD == 1)
+			putss("T: edge-LE time (TC: clr)\n");
+#endif
+#if (SLICE_CMD == 1)
+			putss("S: task slice time (SC: clr, SR: CH CRC16 time)\n");
+#endif
+			putss("Bn: baud, n = 0:9600 1:19200 2:57600 3:115200\n");
+#if (BULK_CMD == 1)
+			putss("U: bulk upload (M lines, XON/XOFF, end w/ \".\")\n");
+#endif
+#if (XM_CMD == 1)
+			putss("XR: XMODEM rcv CH image\t\tXS: XMODEM send CH image\n");
+#endif
+#if (BIN_CMD == 1)
+			putss("#: binary framed cmd mode\n");
+#endif
+			putss("\nMaxValid ch if bcdin = 0xXF\n");			// send help screen
+			break;
+	}
+	cleanline();								// clean up rest of current line
+	if(cmd_ok){
+		tmr_stop(TMR_BAUD);						// host is talking at the new rate
+	}
+	if(cmd_state == CMD_IDLE){
+		cmd_done();								// else, cmd_task() finishes the cmd
+	}
+	return;
+}
+
+// *********************************************
+//  *************** SUBROUTINES ***************
+// *********************************************
+
+//-----------------------------------------------------------------------------
+// poll_port() processes FSEL/PTT changes
+//-----------------------------------------------------------------------------
+//
+// Once the port inputs have been stable for DBOUNCE_MS, a change in the PTT or FSEL
+//	inputs selects the new channel and queues it to the PLL.  The status message is left
+//	in ch_msg for out_task().  Besides the port task, this Fn is called from the wait
+//	loops in wait() and putch(), so it must not do any serial output.
+//
+void poll_port(void){
+	U8	i;				// temp
+	U8	maxtemp;		// maxval temp port reg
+	U8	PBtemp;			// PB temp holding
+	U8	PTTtemp;		// PTT temp holding reg
+	U8	CHtemp;			// channel temp
+	U32* tptr;			// reg pointer
+	bit	settled;		// port inputs stable
+	bit	EA_save;
+
+	EA_save = EA;								// PBraw, PTTraw, and edge_stamp are set by port_intr
+	EA = 0;
+	settled = !tmr_run(TMR_PORT);
+	PBtemp = PBraw;
+	PTTtemp = PTTraw;
+#if (LAT_CMD == 1)
+	if(settled && edge_pend){
+		lat_edge = edge_stamp;					// claim the edge time for this update
+		edge_pend = 0;
+	}
+#endif
+	EA = EA_save;
+	if(settled && ((PBtemp != PBreg) || (PTTtemp != PTTreg))){ // look for a change in (settled) port state
+		// this only runs if there is a change in state
+		maxtemp = 0xff;							// invalid maxtem
+//			if((PTTtemp != PTTreg) || ((PTTtemp == PTTreg) && (PTTreg == 0))){ // if(pttedge OR (!pttedge && ptt==gnd))...
+		if((PTTtemp != PTTreg) || (PTTreg == 0)){ // if(pttedge OR (!pttedge && ptt==gnd))...
+			if((PBtemp & 0x0f) > 0x09){			// look for "max valid search" semaphore (any non-BCD in 1's digit)
+				maxtemp = PBtemp;				// save port reg so we can preserve the change detect logic..
+				CHtemp = chs_maxvalid();		// ..because we are going to use PBreg to squeeze in the max chan selection
+				i = CHtemp / 10;				// set PBtemp = BCD code for max valid channel#
+				PBtemp = CHtemp - (i * 10);		// LSnyb = 1's (remainder)
+				PBtemp |= i << 4;				// MSnyb = 10's
+			}
+		}
+		CHtemp = 0;								// set CH0 as default
+		if(PTTtemp != PTTreg){
+			PTTreg = PTTtemp;					// update edge detect
+			PBreg = PBtemp;						// copy the new port state to memory just in case it chaged at same time as PTT
+			if(PTTreg == 0){					// if PTT active (grounded):
+				CHtemp = conv_to_chnum(PBreg);	// convert port state to channel#
+			}
+		}else{
+			PBreg = PBtemp;						// copy the new port state to memory
+			temp_active = 0;					// abandon temp regs
+			if(PTTreg == 0){					// only update PLL if PTT = gnd
+				CHtemp = conv_to_chnum(PBreg);	// convert port state to channel#
+			}
+		}
+		if(CHtemp <= PBMAX){					// if valid channel#:
+			if(in_cmd) preempt_cnt++;			// PLL update made in the middle of a serial cmd
+#if (LAT_CMD == 1)
+			lat_pend = 1;						// measure edge to LE time
+			le_new = 0;
+#endif
+			if((!temp_active) || (CHtemp == 0)){
+				tptr = get_chan(chs_valid(CHtemp) ? CHtemp : 0); // R5 of CH (default to ch#00 if R5 is 0xffffffff, i.e., ch is empty)
+				send_pll(tptr);					// transfer channel data to PLL
+				ch_msg = CHtemp;				// post status msg
+			}else{
+				send_pll((U32*)&temp_chan[20]);	// C51 longs are MSB first, so temp_chan[] maps onto R0-R5
+				ch_msg = CHMSG_TMP;				// do temp channel
+			}
+			task_rdy |= TSK_OUT;				// post status msg
+		}
+		if(maxtemp != 0xff){
+			PBreg = maxtemp;					// update port reg to hold setting
+		}
+	}
+	return;
+}
+
+#if (LAT_CMD == 1) || (SLICE_CMD == 1)
+//-----------------------------------------------------------------------------
+// stamp_us() returns the time from stamp a to stamp b in us (0xFFFF max)
+//-----------------------------------------------------------------------------
+U16 stamp_us(TSTAMP* a, TSTAMP* b){
+	U16	ms;
+	S32	t;
+
+	ms = b->ms - a->ms;
+	if(ms > 60) return 0xFFFF;
+	t = ((S32)ms * T2_PER) + (S32)b->t2 - (S32)a->t2;	// Timer2 counts
+	if(t < 0) t = 0;
+	return (U16)((t * 49L) / 100L);						// 0.49 us/count (SYSCLK/12)
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// wait() uses ms timer to establish a defined delay
+//-----------------------------------------------------------------------------
+
+void wait(U16 waitms)
+{
+
+	tmr_start(TMR_WAIT, waitms/MS_PER_TIC, 0);
+	while(!tmr_done(TMR_WAIT)){
+		poll_port();					// PTT/FSEL are serviced while waiting
+	}
+}
+
+//-----------------------------------------------------------------------------
+// put_hex
+//-----------------------------------------------------------------------------
+//
+// sends 8b hex to serial port as ASCII
+//
+void put_hex(U8 dhex){
+	char	c;
+	
+	c = (dhex >> 4) + '0';
+	if(c > '9') c += 'A' - '9' - 1;
+	putch(c);
+	c = (dhex & 0x0f) + '0';
+	if(c > '9') c += 'A' - '9' - 1;
+	putch(c);
+	return;
+}
+
+#if (CFG_CMD == 1)
+//-----------------------------------------------------------------------------
+// put_hex32
+//-----------------------------------------------------------------------------
+//
+// sends 32b hex to serial port as ASCII (8 digits)
+//
+void put_hex32(U32 d){
+
+	put_hex((U8)(d >> 24));
+	put_hex((U8)(d >> 16));
+	put_hex((U8)(d >> 8));
+	put_hex((U8)d);
+	return;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// put_dec
+//-----------------------------------------------------------------------------
+//
+// sends 8b hex to serial port as decimal ASCII
+//
+void put_dec(U8 dhex){
+	U8		d;		// bcd temp
+	U8 		i;		// temps
+	U8 		j;
+
+	if(dhex > 99){
+		putss(">>");
+	}else{
+		j = dhex / 10;
+		i = dhex - (j * 10);
 		d = (j << 4) | i;
 		put_hex(d);
 	}
 	return;
 }
 
+//-----------------------------------------------------------------------------
+// put_crc
+//-----------------------------------------------------------------------------
+//
+// sends "CRC16 = 0xhhhh" to serial port
+//
+void put_crc(U16 crc){
+
+	putss("\nCRC16 = 0x");
+	put_hex((U8)(crc >> 8));
+	put_hex((U8)(crc & 0xff));
+	putss("\n");
+	return;
+}
+
+#if CHS_FLAT && (CRCQ_CMD == 1)
+//-----------------------------------------------------------------------------
+// crc_sect
+//-----------------------------------------------------------------------------
+//
+// sets up the CMD_CRC query for the CH bytes in sector# sect
+//
+void crc_sect(U8 sect){
+
+	cx_ptr = (U8 code *)CHAN_ADDR + chs_sectoff(sect);
+	cx_len = chs_sectoff(sect + 1) - chs_sectoff(sect);
+	cx_crc = 0;
+	return;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// put_dec16
+//-----------------------------------------------------------------------------
+//
+// sends 16b value to serial port as decimal ASCII (no leading zeros)
+//
+void put_dec16(U16 d){
+	U8	i;
+	char	buf[5];
+
+	for(i=0; i<5; i++){
+		buf[i] = (d % 10) + '0';				// ls digit first
+		d /= 10;
+	}
+	while((i > 1) && (buf[i-1] == '0')){		// skip leading zeros
+		i--;
+	}
+	do{
+		putch(buf[--i]);
+	}while(i != 0);
+	return;
+}
+
 //--------------------------------------------------------------------------------------
 // getbyte() returns 1 if no EOL is encountered: processes ASCII byte into pointer location.
 //	skips spaces.  Other chars are data error.
@@ -966,6 +2037,59 @@ U8 getbyte(U8* dataptr){
 	return rtn;
 }
 
+//--------------------------------------------------------------------------------------
+// get_chnum() gets a 2 digit (decimal) ch#.  returns CH_BAD if not 2 digits or out of range.
+//--------------------------------------------------------------------------------------
+U8 get_chnum(void){
+	U8	c;
+	U8	i;
+
+	c = getch00();
+	if((c < '0') || (c > '9')) return CH_BAD;
+	i = (c & 0x0f) * 10;
+	c = getch00();
+	if((c < '0') || (c > '9')) return CH_BAD;
+	i += c & 0x0f;
+	if(i >= NUM_CHAN) return CH_BAD;
+	return i;
+}
+
+#if (SYN_CMD == 1) || (CFG_CMD == 1)
+//--------------------------------------------------------------------------------------
+// get_dec() gets a decimal number w/ an optional decimal point (leading spaces are skipped).
+//	returns the number * 10^ndp (extra fraction digits are dropped), 0 if there are no digits,
+//	or DEC_BAD if it doesn't fit in 32 bits.
+//--------------------------------------------------------------------------------------
+U32 get_dec(U8 ndp){
+	U32	d;
+	U8	c;
+	U8	dp;			// decimal point seen
+
+	while(whitespc(rxd_peek(0))) getch00();
+	d = 0;
+	dp = 0;
+	for(;;){
+		c = rxd_peek(0);
+		if((c == '.') && !dp){
+			dp = 1;
+		}else{
+			if((c < '0') || (c > '9')) break;
+			if(!dp || ndp){
+				if(d > 429496728L) return DEC_BAD;
+				d = (d * 10) + (c & 0x0f);
+				if(dp) ndp--;
+			}
+		}
+		getch00();
+	}
+	while(ndp--){
+		if(d > 429496728L) return DEC_BAD;
+		d *= 10;
+	}
+	return d;
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // whitespc() returns 1 if chr = space, comma, or tab, else returns 0
 //--------------------------------------------------------------------------------------
@@ -1005,7 +2129,11 @@ U8 convnyb(U8 c){
 U32 *get_chan(U8 chanum){
 	U32 *ptemp;
 	
+#if !CHS_FLAT
+	ptemp = (U32 *)(chs_chan(chanum) + 20);	// R5 is the last 4 bytes of the CH
+#else
 	ptemp = pll_ch + (6 * chanum) + 5;		// channel pointer is base + #regs * ch# + 5
+#endif
 	return ptemp;
 }
 
@@ -1053,31 +2181,29 @@ void pca_intr(void) interrupt 9 using 2
     return;
 }
 //-----------------------------------------------------------------------------
-// Timer2_ISR
+// port_intr
 //-----------------------------------------------------------------------------
 //
-// Called when timer 2 overflows (NORM mode):
-//      updates app timers @ 10ms rate
-//		rate = (sysclk/12) / (65536 - TH:L)
+// Port match intr.  Any change on FSEL[7:0] (P1) or /PTT (P0.3) lands here.  The match
+//	regs are loaded with the new port state (clears the match), the new state is passed
+//	to poll_port() through PBraw/PTTraw, and the settle timer is restarted.  The first
+//	edge after an update is time stamped for the edge to LE measurement.
 //
-//-----------------------------------------------------------------------------
-
-void Timer2_ISR(void) interrupt 5 using 2
+void port_intr(void) interrupt 14 using 2
 {
 
-    TF2H = 0;                           // Clear Timer2 interrupt flag
-    if(waittimer != 0){                 // g.p. delay timer
-        waittimer--;
-    }
-    if(dbounce_tmr != 0){               // pbsw debounce timer
-        dbounce_tmr--;
-        if(dbounce_tmr == 0){
-//            pb_state(PB_NORM);          // process switch state machine
-        }
-    }
-//    if(temptimer != 0){                 // temperature delay timer
-//        temptimer--;
-//    }
+	P0MAT = P0;							// re-arm for the next change
+	P1MAT = P1;
+	PBraw = ~P1MAT;						// convert port to POS logic
+	PTTraw = (P0MAT >> 3) & 0x01;		// /PTT
+	TMR_ISR_START(TMR_PORT, DBOUNCE_MS);	// restart settle timer
+#if (LAT_CMD == 1)
+	if(!edge_pend){
+		T2_STAMP(edge_stamp);
+		edge_pend = 1;
+	}
+#endif
+	return;
 }
 
 #undef IS_MAINC
@@ -0,0 +1,536 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: pll.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the ADF4351 SPI driver module.  Register sets are
+ *             compared against a shadow of the last set sent, and the
+ *             changed registers are clocked out by an SPI0/Timer0 interrupt
+ *             state machine so that the main loop does not wait on the SPI.
+ *
+ *			   CFG_CMD: the unit config (pll_cfg) is applied to each set as it is queued: the reg overlays
+ *			   (AND/OR masks, e.g. to set the output power or MTLD for every channel), then the
+ *			   reference correction to R0/R1.  The stored channels are the same for every unit.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						send_spi32(), delay_halfbit(), and send_pll() moved here from main.c
+ *						HWSPI transfers are now interrupt driven.  The transmit queue is a bitmap of
+ *							pending registers (spi_pend) over pll_shadow[], which coalesces a new register
+ *							set with one that is still being sent and holds the R5 -> R0 send order.
+ *						Added the reference ppm correction (pll_setppm(), ppm_adj()).
+ *						Added the reg overlays (pll_setovl(), ovl_apply()).  The ppm and overlays are
+ *							the pll_cfg image, which chstore.c saves.  Only built if CFG_CMD = 1.
+ *						ppm_adj() picks FRAC/MOD (MOD <= 4095) as the best rational approximation of the
+ *							corrected N, instead of always using MOD = 4095.
+ *						The LE time stamp (le_stamp) is only kept if LAT_CMD = 1.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#define PLL_INCL
+#include "pll.h"
+
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	R2_DBUF		0x00002000L	// R2 double buffer enable (R4 divider select waits for R0 write)
+#define	R4_DIVSEL	0x00700000L	// R4 RF divider select field
+#define	R0_NFRAC	0x7FFFFFF8L	// R0 INT and FRAC fields
+#define	R1_MOD		0x00007FF8L	// R1 MOD field
+#define	R1_PHASE	0x07FF8000L	// R1 phase field
+#define	PPM_MOD		4095		// max MOD of a corrected set
+#define	PPM_FB		20			// ppm_adj(): fraction bits of N
+#define	PPM_ONE		(1L << PPM_FB)
+
+#if (REVC_HW == 1)
+#define	LE_ON	1
+#define	LE_OFF	0
+#else
+#define	LE_ON	0
+#define	LE_OFF	1
+#endif
+
+#if (REVC_HW == 1)
+#define	PLL_LOCK	0
+#else
+#define	PLL_LOCK	1
+#endif
+
+#ifdef BB_SPI
+	// BitBangSPI version uses HW timer0 to establish the bit-delay (200us, nominal)
+	// T0 has about 0.5us of delay per timer tic when configured for clock source = SYSCLK/12
+	// define 200us timer delay @24.5MHz/12 timer clock = (65536 - (400*0.5us))
+#define	T0_VALUE	65136
+#else
+	// HWSPI version uses HW timer0 to establish quick delay (8us, nominal)
+	// T0 has about 0.5us of delay per timer tic when configured for clock source = SYSCLK/12
+	// define 8us timer delay @24.5MHz/12 timer clock = (65536 - (16*0.5us))
+#define	T0_VALUE	0xFFF0
+#endif
+
+// spi_state values (HWSPI interrupt state machine)
+#define	SPI_IDLE	0			// no transfer in progress
+#define	SPI_LOAD	1			// T0: gap done, load next pending reg (or go idle)
+#define	SPI_SETUP	2			// T0: LE setup done, start shifting bytes
+#define	SPI_SHIFT	3			// SPI: byte done, send next or start LE hold
+#define	SPI_HOLD	4			// T0: LE hold done, release LE and start the inter-word gap
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+// port assignments
+
+sbit SCK        = P0^0;				// (o) SPI SCLK
+sbit MISO       = P0^1;				// (i) SPI MISO/LDET
+sbit MOSI       = P0^2;				// (o) SPI MOSI
+sbit nPLL_LE	= P0^7;				// (o) SPI LE
+
+U32 idata pll_shadow[NUM_REG];		// copy of the last register set sent to the ADF4351 (R0 - R5)
+bit	shadow_ok;						// pll_shadow[] valid flag (clear to force a full re-send)
+U8	spi_pend;						// bitmap of registers waiting to be sent (bit n = Rn)
+#if (CFG_CMD == 1)
+PLLCFG data pll_cfg;				// unit config (ref correction, reg overlays)
+#endif
+bit	pll_done;						// set when all queued registers have been latched into the ADF4351
+#if (LAT_CMD == 1)
+bit	le_new;							// le_stamp updated
+TSTAMP le_stamp;					// time of the LE that completed the last register set
+#endif
+#ifndef BB_SPI
+U8	spi_state;						// SPI state machine
+U8	spi_bcnt;						// SPI byte count
+U8	idata spi_word[4];				// word being shifted (MSB first)
+#endif
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+#if (CFG_CMD == 1)
+void ppm_adj(U32 idata * r);
+U32 ovl_apply(U8 reg, U32 d);
+#endif
+#ifdef BB_SPI
+void send_spi32(U32 plldata);
+void delay_halfbit(void);
+#endif
+
+//-----------------------------------------------------------------------------
+// init_pll() initializes SPI port pins and driver vars
+//-----------------------------------------------------------------------------
+//
+void init_pll(void){
+#if (CFG_CMD == 1)
+	U8	i;
+#endif
+
+#ifndef	BB_SPI
+    XBR0      = 0x03;						// enable hdwr SPI on xbar
+    SPI0CN    = 0x01;						// enable hdwr SPI
+	spi_state = SPI_IDLE;
+	ESPI0 = 1;								// SPI and T0 intrpts drive the xfr
+	ET0 = 1;
+#endif
+	SCK = 0;								// init SPI pins
+	MISO = 1;
+	nPLL_LE = LE_OFF;
+	shadow_ok = 0;							// first channel sent to the PLL is a full register set
+#if (CFG_CMD == 1)
+	pll_cfg.ppm = 0;						// (chs_loadcfg() loads the saved config)
+	for(i=0; i<OVL_NUM; i++){
+		pll_cfg.oreg[i] = OVL_NONE;
+	}
+#endif
+	spi_pend = 0;
+	pll_done = 1;
+#if (LAT_CMD == 1)
+	le_new = 0;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// pll_invalidate() forces the next send_pll() to send all registers
+//-----------------------------------------------------------------------------
+//
+void pll_invalidate(void){
+
+	shadow_ok = 0;
+}
+
+#if (CFG_CMD == 1)
+//-----------------------------------------------------------------------------
+// pll_setovl() sets the overlay of reg# reg to (reg & oand) | oor for the next send_pll()
+//	(the control bits are kept).  oand = 0xffffffff and oor = 0 clears it.  returns 1 if
+//	all OVL_NUM overlays are in use (or reg is bad).
+//-----------------------------------------------------------------------------
+//
+U8 pll_setovl(U8 reg, U32 oand, U32 oor){
+	U8	i;
+	U8	j;
+
+	if(reg >= NUM_REG) return 1;
+	j = OVL_NONE;
+	for(i=0; i<OVL_NUM; i++){
+		if(pll_cfg.oreg[i] == reg) break;
+		if((pll_cfg.oreg[i] == OVL_NONE) && (j == OVL_NONE)) j = i;	// 1st free
+	}
+	if(i == OVL_NUM){
+		if(j == OVL_NONE) return 1;
+		i = j;
+	}
+	oand |= OVL_CTL;
+	oor &= ~OVL_CTL;
+	if((oand == 0xffffffffL) && (oor == 0)){
+		pll_cfg.oreg[i] = OVL_NONE;
+	}else{
+		pll_cfg.oreg[i] = reg;
+		pll_cfg.oand[i] = oand;
+		pll_cfg.oor[i] = oor;
+	}
+	return 0;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// pll_lock() returns 1 if the ADF4351 reports lock (on MISO/LDET)
+//-----------------------------------------------------------------------------
+//
+U8 pll_lock(void){
+
+	return (MISO == PLL_LOCK);
+}
+
+//-----------------------------------------------------------------------------
+// send_pll
+//-----------------------------------------------------------------------------
+//
+// queues a channel register set for the ADF4351.  rptr points to R5 of the set.
+//	Only registers that differ from pll_shadow[] are queued.  R0 is also queued if
+//	R1-R3 changed, or if the R4 divider changed and R2 has double buffering enabled.
+//	A change to R4 power/divider or to R5 alone skips the R0 write (no VCO band select).
+//	The set is copied, so the source may change as soon as this Fn returns.  CFG_CMD: the
+//	regs are overlaid, and R0/R1 corrected for pll_cfg.ppm (if not 0), first.
+//	HWSPI: returns immediately, pll_done is set by the ISR when the last reg is latched.
+//	BB_SPI: returns after the regs are sent.
+//
+void send_pll(U32* rptr){
+	U8	i;			// reg#
+	U8	m;			// reg mask
+	U32	d;			// reg data
+	bit	r0_req;		// R0 write required
+	bit	div_chg;	// R4 divider changed
+	bit	EA_save;
+#if (CFG_CMD == 1)
+	U32 idata nreg[2];	// R0, R1 (corrected)
+
+	nreg[0] = ovl_apply(0, rptr[-5]);
+	nreg[1] = ovl_apply(1, rptr[-4]);
+	if(pll_cfg.ppm) ppm_adj(nreg);
+#endif
+	r0_req = !shadow_ok;
+	div_chg = 0;
+	EA_save = EA;								// shadow is shared with the SPI ISR
+	EA = 0;
+	for(i=NUM_REG-1, m=1<<(NUM_REG-1); i!=0; i--, m>>=1){
+#if (CFG_CMD == 1)
+		d = (i == 1) ? nreg[1] : ovl_apply(i, *rptr);
+#else
+		d = *rptr;
+#endif
+		rptr--;
+		if((d != pll_shadow[i]) || !shadow_ok){
+			if(i < 4) r0_req = 1;						// R1-R3 take effect on the R0 write
+			if((i == 4) && ((d ^ pll_shadow[4]) & R4_DIVSEL)) div_chg = 1;
+			pll_shadow[i] = d;
+			spi_pend |= m;
+		}
+	}
+	if(div_chg && (pll_shadow[2] & R2_DBUF)) r0_req = 1;	// double-buffered divider waits for R0
+#if (CFG_CMD == 1)
+	d = nreg[0];
+#else
+	d = *rptr;									// (rptr is at R0)
+#endif
+	if(r0_req || (d != pll_shadow[0])){
+		pll_shadow[0] = d;
+		spi_pend |= 0x01;
+	}
+	shadow_ok = 1;
+#ifdef BB_SPI
+	EA = EA_save;
+	for(i=NUM_REG-1, m=1<<(NUM_REG-1); m!=0; i--, m>>=1){
+		if(spi_pend & m){
+			spi_pend &= ~m;
+			send_spi32(pll_shadow[i]);
+		}
+	}
+	pll_done = 1;
+	EA = 0;
+#if (LAT_CMD == 1)
+	T2_STAMP(le_stamp);
+	le_new = 1;
+#endif
+	task_rdy |= TSK_PLL;
+	EA = EA_save;
+#else
+	if(spi_pend){
+		pll_done = 0;
+		if(spi_state == SPI_IDLE){
+			spi_state = SPI_LOAD;				// kick-start: T0 ISR loads the 1st reg
+			TF0 = 1;
+		}
+	}
+	EA = EA_save;
+#endif
+	return;
+}
+
+#if (CFG_CMD == 1)
+//-----------------------------------------------------------------------------
+// ppm_adj() corrects the R0/R1 pair at r[] for pll_cfg.ppm: N' = N * (1 - ppm).  FRAC/MOD is the
+//	best rational approximation (MOD <= PPM_MOD) of the fraction of N' (continued fraction
+//	convergents, then the best semiconvergent).  The control and prescaler bits are kept, and the
+//	phase if it is < MOD (else it is set to 1).  A fraction within 1/PPM_MOD of an integer can't
+//	do better than 1/PPM_MOD, so the worst case error is 1 / (2 * PPM_MOD * N) (0.12 ppm @ N = 1000,
+//	1.2 ppm @ N = 100), typ a few ppb.
+//-----------------------------------------------------------------------------
+//
+void ppm_adj(U32 idata * r){
+	U16	ni;			// INT of N
+	U32	nx;			// fraction of N (1/PPM_ONE)
+	U32	t;
+	U32	num;		// continued fraction remainders
+	U32	den;
+	U32	a;
+	U16	p;
+	U16	h0;			// convergents h0/k0, h1/k1
+	U16	k0;
+	U16	h1;
+	U16	k1;
+	U16	h;
+	U16	k;
+
+	k = (U16)(r[1] >> 3) & 0x0fff;			// MOD
+	if(k == 0) return;
+	ni = (U16)(r[0] >> 15);
+	nx = ((((r[0] >> 3) & 0x0fff) << PPM_FB) + (k / 2)) / k;
+	p = (pll_cfg.ppm < 0) ? -pll_cfg.ppm : pll_cfg.ppm;
+	t = ((U32)ni * p) + (((nx >> 4) * p) >> 16);	// N * |ppm| (0.01 ppm = 1E-8)
+	t = ((t / 390625) << 12) + ((((t % 390625) << 12) + 195312) / 390625);	// in 1/PPM_ONE (2^20 / 1E8 = 4096 / 390625)
+	if(pll_cfg.ppm < 0){
+		nx += t & (PPM_ONE - 1);
+		ni += (U16)(t >> PPM_FB) + (U16)(nx >> PPM_FB);
+		nx &= PPM_ONE - 1;
+	}else{
+		ni -= (U16)(t >> PPM_FB);
+		t &= PPM_ONE - 1;
+		if(nx < t){
+			ni--;
+			nx += PPM_ONE;
+		}
+		nx -= t;
+	}
+	h0 = 0;
+	k0 = 1;
+	h1 = 1;
+	k1 = 0;
+	num = nx;
+	den = PPM_ONE;
+	while(den){
+		a = num / den;
+		if(k1 && (a > ((PPM_MOD - k0) / k1))){
+			a = (PPM_MOD - k0) / k1;		// largest semiconvergent, use it if it is closer
+			if(a){
+				h = h0 + ((U16)a * h1);
+				k = k0 + ((U16)a * k1);
+				num = nx * k1 - ((U32)h1 << PPM_FB);		// errors (mod 2^32, then abs)
+				den = nx * k - ((U32)h << PPM_FB);
+				if((S32)num < 0) num = -num;
+				if((S32)den < 0) den = -den;
+				if((den * k1) < (num * k)){
+					h1 = h;
+					k1 = k;
+				}
+			}
+			break;
+		}
+		h = ((U16)a * h1) + h0;
+		k = ((U16)a * k1) + k0;
+		h0 = h1;
+		k0 = k1;
+		h1 = h;
+		k1 = k;
+		t = num - (a * den);
+		num = den;
+		den = t;
+	}
+	if(h1 == k1){
+		ni++;								// rounded up to 1/1
+		h1 = 0;
+	}
+	if(k1 < 2){
+		k1 = 2;								// (min MOD)
+		h1 *= 2;
+	}
+	r[0] = (r[0] & ~R0_NFRAC) | ((U32)ni << 15) | ((U32)h1 << 3);
+	if(((U16)(r[1] >> 15) & 0x0fff) >= k1){
+		r[1] = (r[1] & ~R1_PHASE) | (1L << 15);	// phase must be < MOD
+	}
+	r[1] = (r[1] & ~R1_MOD) | ((U32)k1 << 3);
+}
+
+//-----------------------------------------------------------------------------
+// ovl_apply() returns reg# reg data d w/ its overlay (if any) applied
+//-----------------------------------------------------------------------------
+//
+U32 ovl_apply(U8 reg, U32 d){
+	U8	i;
+
+	for(i=0; i<OVL_NUM; i++){
+		if(pll_cfg.oreg[i] == reg){
+			d = (d & pll_cfg.oand[i]) | pll_cfg.oor[i];
+		}
+	}
+	return d;
+}
+#endif
+
+#ifdef BB_SPI
+//-----------------------------------------------------------------------------
+// send_spi32
+//-----------------------------------------------------------------------------
+//
+// sends 32 bit word to ADS4351 via port4 bit-bang SPI
+//
+void send_spi32(U32 plldata){
+	U32	mask;
+
+	nPLL_LE = LE_ON;								// latch enab = low to clock in data
+	for(mask = 0x80000000; mask != 0; mask >>= 1){	// start shifting 32 bits starting at MSb
+		if(mask & plldata) MOSI = 1;				// set MOSI
+		else MOSI = 0;
+		delay_halfbit();							// delay half clock
+		SCK = 1;									// clock = high
+		delay_halfbit();							// delay remaining half
+		SCK = 0;									// clock low
+	}
+	delay_halfbit();								// delay for LE
+	nPLL_LE = LE_OFF;								// latch enab = high to latch data
+	delay_halfbit();								// pad intra-word xfers by a half bit
+	return;	
+}
+
+//-----------------------------------------------------------------------------
+// delay_halfbit
+//-----------------------------------------------------------------------------
+//
+// sets delay for spi SCK and for CS setup/hold
+//
+void delay_halfbit(void){
+
+	TH0 = (T0_VALUE >> 8);							// prep timer registers for delay
+	TL0 = (T0_VALUE & 0xFF);
+	TF0 = 0;
+	TR0 = 1;										// start timer
+	while(TF0 == 0);								// loop
+	TR0 = 0;										// stop timer
+	return;	
+}
+
+#else
+//-----------------------------------------------------------------------------
+// spi_t0_intr
+//-----------------------------------------------------------------------------
+//
+// Timer0 intr.  Times the LE setup/hold and inter-word gaps (T0_VALUE, ~8us) for the HWSPI
+//	state machine.  The word is sent as: LE_ON, delay, 4 bytes (SPI ISR), delay, LE_OFF, delay.
+//	Pending regs are sent highest reg# first so that R0 is always last.
+//
+void spi_t0_intr(void) interrupt 1 using 2
+{
+	U8	i;
+	U8	m;
+	U8 idata * p;
+
+	TR0 = 0;										// one-shot
+	TF0 = 0;
+	switch(spi_state){
+		case SPI_LOAD:
+			if(spi_pend == 0){
+				spi_state = SPI_IDLE;				// queue empty
+#if (LAT_CMD == 1)
+				T2_STAMP(le_stamp);					// time stamp the set completion
+				le_new = 1;
+#endif
+				pll_done = 1;
+				task_rdy |= TSK_PLL;				// wake the PLL task
+				break;
+			}
+			for(i=NUM_REG-1, m=1<<(NUM_REG-1); !(spi_pend & m); i--, m>>=1);
+			spi_pend &= ~m;
+			p = (U8 idata *)&pll_shadow[i];			// latch the word (C51 longs are MSB first)
+			spi_word[0] = *p++;
+			spi_word[1] = *p++;
+			spi_word[2] = *p++;
+			spi_word[3] = *p;
+			nPLL_LE = LE_ON;						// latch enab = low to clock in data
+			spi_state = SPI_SETUP;
+			TH0 = (T0_VALUE >> 8);					// pad intra-word xfers by a half bit
+			TL0 = (T0_VALUE & 0xFF);
+			TR0 = 1;
+			break;
+
+		case SPI_SETUP:
+			spi_bcnt = 1;
+			spi_state = SPI_SHIFT;
+			SPI0DAT = spi_word[0];					// SPI ISR sends the rest
+			break;
+
+		case SPI_HOLD:
+			nPLL_LE = LE_OFF;						// latch data
+			spi_state = SPI_LOAD;
+			TH0 = (T0_VALUE >> 8);					// delay for RC pullup on revC CS line
+			TL0 = (T0_VALUE & 0xFF);
+			TR0 = 1;
+			break;
+
+		default:
+			break;
+	}
+	return;
+}
+
+//-----------------------------------------------------------------------------
+// spi_intr
+//-----------------------------------------------------------------------------
+//
+// SPI0 intr.  Sends the remaining bytes of spi_word[], then starts the LE hold delay.
+//
+void spi_intr(void) interrupt 6 using 2
+{
+
+	SPIF = 0;										// clr intr flag
+	if(spi_state == SPI_SHIFT){
+		if(spi_bcnt < 4){
+			SPI0DAT = spi_word[spi_bcnt++];
+		}else{
+			spi_state = SPI_HOLD;					// last byte is out
+			TH0 = (T0_VALUE >> 8);					// pad intra-word xfers by a half bit
+			TL0 = (T0_VALUE & 0xFF);
+			TR0 = 1;
+		}
+	}
+	return;
+}
+#endif
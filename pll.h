@@ -0,0 +1,65 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: pll.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the ADF4351 SPI driver.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Added pll_setppm() (reference correction)
+ *						Replaced pll_setppm() w/ the pll_cfg config image (ppm and reg overlays)
+ *						pll_cfg is in DATA (256 B part, no XRAM).
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// extern defines
+//------------------------------------------------------------------------------
+
+// unit config, applied to each reg set by send_pll() (saved as an image by chs_savecfg())
+typedef struct {
+	S16	ppm;						// ref correction (0.01 ppm, + = ref is high)
+	U8	oreg[OVL_NUM];				// overlay reg# (OVL_NONE = not used)
+	U32	oand[OVL_NUM];				// overlay: reg = (reg & oand) | oor
+	U32	oor[OVL_NUM];
+} PLLCFG;
+
+#define	CFG_DLEN	(2 + (9 * OVL_NUM))	// sizeof(PLLCFG)
+
+#ifndef PLL_INCL
+extern bit pll_done;				// set when the last queued register set has been sent
+#if (LAT_CMD == 1)
+extern bit le_new;					// le_stamp updated (cleared by the application)
+extern TSTAMP le_stamp;				// time of the LE that completed the last register set
+#endif
+#if (CFG_CMD == 1)
+extern PLLCFG data pll_cfg;		// unit config
+#endif
+#endif
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+void init_pll(void);
+void send_pll(U32* rptr);
+void pll_invalidate(void);
+#if (CFG_CMD == 1)
+U8 pll_setovl(U8 reg, U32 oand, U32 oor);
+#endif
+U8 pll_lock(void);
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+#define	NUM_REG	6				// # ADF4351 registers
+#define	OVL_NONE	0xFF			// pll_cfg.oreg[]: overlay not used
+#define	OVL_CTL		0x00000007L		// reg control bits (an overlay can't change them)
@@ -13,6 +13,22 @@
 /********************************************************************
  *  File scope declarations revision history:
  *    05-12-13 jmh:  creation date
+ *    10-17-26 jmh:  added buffered TX (txd_buff[]) drained by rxd_intr.  putch() now
+ *						only waits if the buffer is full and txd_mode = TXD_BLOCK.
+ *						TXD_DROP discards chrs that don't fit, TXD_TRUNC discards the
+ *						rest of the putss() string that filled the buffer.
+ *						rxd_intr makes TSK_CMD ready for each RX chr, and TSK_OUT ready when
+ *						the TX buffer drains to TXD_WAKE or empties.  Added txd_free().
+ *						Added set_baud() (9600 - 115200) and rxd_ovf().  rxd_intr now uses register
+ *						bank 2 (all intrpts are the same priority, so they can share it) and keeps
+ *						the buffer head in a local.
+ *						Added XON/XOFF flow control for RX (set_flow()).  rxd_intr sends XOFF when
+ *						rxd_buff reaches RXD_HIWAT, and getch00() sends XON when it drains to
+ *						RXD_LOWAT.  Flow chrs are sent ahead of txd_buff (txd_ctl).  Added rxd_crpend().
+ *						Added a raw (binary) RX mode, set_rawrx(), and rxd_cnt().
+ *						Added rxd_peek() and rxd_drop() for in-place frame decoding.
+ *						putch() tests txd_run w/ intrpts off (an XOFF from rxd_intr could be clobbered).
+ *						txd_buff[] is 16 B (256 B of RAM, no XRAM).
  *
  *******************************************************************/
 
@@ -20,6 +36,7 @@
 #include "typedef.h"
 #include "init.h"
 //#include "stdio.h"
+#define SERIAL_INCL
 #include "serial.h"
 
 //------------------------------------------------------------------------------
@@ -35,13 +52,34 @@
 #define RXD_BS 0x04					// BS rcvd flag
 #define RXD_ESC 0x40				// ESC rcvd flag
 #define RXD_CHAR 0x80				// CHAR rcvd flag (not used)
-#define RXD_BUFF_END 64
+#define RXD_BUFF_END (RXD_MAX + 1)	// must be a power of 2 (see rxd_intr)
+#define	RXD_HIWAT	40				// send XOFF at this # chrs in rxd_buff (leaves room for host FIFO)
+#define	RXD_LOWAT	16				// send XON at this # chrs in rxd_buff
+#define	RXD_FILL	((rxd_hptr - rxd_tptr) & (RXD_BUFF_END - 1))
 idata S8	rxd_buff[RXD_BUFF_END];		// rx data buffer
 U8	rxd_hptr;					// rx buf head ptr = next available buffer input
 U8	rxd_tptr;					// rx buf tail ptr = next available buffer output
 U8	rxd_stat;					// rx buff status
 U8	rxd_crcnt;					// CR counter
-bit	qTI0B;						// UART TI0 reflection (set by interrupt)
+#define TXD_BUFF_END 16				// must be a power of 2 (see txd_free())
+#define	TXD_WAKE	3				// wake the out task at this # chrs in txd_buff (frees a DUMP_FLD)
+idata S8	txd_buff[TXD_BUFF_END];		// tx data buffer
+U8	txd_hptr;					// tx buf head ptr = next available buffer input
+U8	txd_tptr;					// tx buf tail ptr = next chr to send
+U8	txd_mode;					// tx buffer full policy
+bit	txd_run;					// TX active (intr is draining txd_buff)
+bit	txd_ovf;					// chr discarded since last putss()
+U8	txd_ctl;					// flow control chr to send ahead of txd_buff (0 = none)
+bit	rxd_flow;					// XON/XOFF flow control enabled
+bit	rxd_xoff;					// XOFF sent
+bit	rxd_raw;					// binary RX (no line editing, ESC, or CR count)
+// send a flow control chr.  Call with intrpts off (or from rxd_intr).
+#define	TXD_CTL(ch)	{ if(txd_run){ txd_ctl = (ch); }else{ txd_run = 1; SBUF0 = (ch); } }
+// baud rate table (BAUD_xxx).  Timer1 is clocked by SYSCLK/12, or by SYSCLK if T1M (CKCON.3) is set.
+//	baud = T1CLK / (2 * (256 - TH1))
+U16 code baud100[NUM_BAUD] = { 96, 192, 576, 1152 };	// baud / 100 (for display)
+U8 code baud_th1[NUM_BAUD] = { 0x96, 0xCB, 0x2B, 0x96 };	// 9631, 19261, 57512, 115566 @24.5MHz
+U8 code baud_t1m[NUM_BAUD] = { 0x00, 0x00, 0x08, 0x08 };	// CKCON.T1M
 //------------------------------------------------------------------------------
 // local fn declarations
 //------------------------------------------------------------------------------
@@ -51,27 +89,188 @@ bit	qTI0B;						// UART TI0 reflection (set by interrupt)
 //-----------------------------------------------------------------------------
 //
 void init_serial(void){
-	qTI0B = 1;					// UART TI0 reflection (set by interrupt)
+	txd_hptr = 0;				// tx buf head ptr
+	txd_tptr = 0;				// tx buf tail ptr
+	txd_mode = TXD_POLICY;		// tx buf full policy
+	txd_run = 0;
+	txd_ovf = 0;
+	txd_ctl = 0;
+	rxd_flow = 0;
+	rxd_xoff = 0;
+	rxd_raw = 0;
 	rxd_hptr = 0;				// rx buf head ptr
 	rxd_tptr = 0;				// rx buf tail ptr
 	rxd_stat = 0;				// rx buff status
 	rxd_crcnt = 0;				// init cr counter
 }
+//
+//-----------------------------------------------------------------------------
+// set_txmode() sets the tx buffer full policy, returns the previous policy
+//-----------------------------------------------------------------------------
+//
+U8 set_txmode(U8 mode){
+	U8	i;
+
+	i = txd_mode;
+	txd_mode = mode;
+	return i;
+}
+
+//
+//-----------------------------------------------------------------------------
+// set_baud() sets the UART baud rate (BAUD_xxx).  Waits for TX to go idle first.
+//-----------------------------------------------------------------------------
+//
+void set_baud(U8 b){
+
+	while(txd_run){				// let the last chr finish at the old rate
+		poll_port();			// ..PTT/FSEL are serviced while waiting
+	}
+	TR1 = 0;
+	CKCON = (CKCON & ~0x08) | baud_t1m[b];
+	TH1 = baud_th1[b];
+	TL1 = baud_th1[b];
+	TR1 = 1;
+}
+
+//
+//-----------------------------------------------------------------------------
+// set_flow() enables (on != 0) or disables XON/XOFF flow control.  Sends XON if
+//	flow control is turned off while the host is held off.
+//-----------------------------------------------------------------------------
+//
+void set_flow(U8 on){
+	bit	EA_save;
+
+	EA_save = EA;				// prohibit intrpts
+	EA = 0;
+	rxd_flow = (on != 0);
+	if(!rxd_flow && rxd_xoff){
+		rxd_xoff = 0;
+		TXD_CTL(XON);
+	}
+	EA = EA_save;				// re-set intrpt enable
+}
+
+//
+//-----------------------------------------------------------------------------
+// set_rawrx() turns binary RX mode on (on != 0) or off.  rxd_buff is flushed.
+//-----------------------------------------------------------------------------
+//
+void set_rawrx(U8 on){
+	bit	EA_save;
+
+	EA_save = EA;				// prohibit intrpts
+	EA = 0;
+	rxd_raw = (on != 0);
+	rxd_hptr = 0;				// flush rx buffer
+	rxd_tptr = 0;
+	rxd_crcnt = 0;
+	rxd_stat &= ~RXD_BS;
+	EA = EA_save;				// re-set intrpt enable
+}
+
+//
+//-----------------------------------------------------------------------------
+// rxd_cnt() returns the # chrs in rxd_buff (use in raw mode, where '\0' is data)
+//-----------------------------------------------------------------------------
+//
+U8 rxd_cnt(void){
+
+	return RXD_FILL;
+}
+
+//
+//-----------------------------------------------------------------------------
+// rxd_peek() returns chr i of rxd_buff (0 = next chr) without removing it
+//-----------------------------------------------------------------------------
+//
+U8 rxd_peek(U8 i){
+
+	return rxd_buff[(rxd_tptr + i) & (RXD_BUFF_END - 1)];
+}
+
+//
+//-----------------------------------------------------------------------------
+// rxd_drop() removes n chrs from rxd_buff (raw mode)
+//-----------------------------------------------------------------------------
+//
+void rxd_drop(U8 n){
+
+	rxd_tptr = (rxd_tptr + n) & (RXD_BUFF_END - 1);
+}
+
+//
+//-----------------------------------------------------------------------------
+// rxd_crpend() returns the # of complete lines (CRs) in rxd_buff.  Unlike gotcr(),
+//	the count is not changed (getch00() takes the CR off the count when it pulls it).
+//-----------------------------------------------------------------------------
+//
+U8 rxd_crpend(void){
+
+	return rxd_crcnt;
+}
+
+//
+//-----------------------------------------------------------------------------
+// rxd_ovf() returns 1 if rxd_buff has overflowed.  Clears the flag if clr != 0.
+//-----------------------------------------------------------------------------
+//
+U8 rxd_ovf(U8 clr){
+	U8	i;
+
+	i = rxd_stat & RXD_ERR;
+	if(clr){
+		rxd_stat &= ~RXD_ERR;	// ANL direct is atomic wrt the intr
+	}
+	return (i != 0);
+}
+
+//
+//-----------------------------------------------------------------------------
+// txd_free() returns the # chrs that can be added to txd_buff without waiting
+//-----------------------------------------------------------------------------
+//
+U8 txd_free(void){
+
+	return (txd_tptr - txd_hptr - 1) & (TXD_BUFF_END - 1);
+}
+
 //
 //-----------------------------------------------------------------------------
 // putch, UART0
 //-----------------------------------------------------------------------------
 //
-// SFR Paged version of putch, no CRLF translation
+// Buffered putch, no CRLF translation.  Places chr in txd_buff[] and kick-starts
+//	the TX intr if it is idle.  If the buffer is full, TXD_BLOCK waits for space,
+//	else the chr is discarded (txd_ovf is set).
 //
 char putch (char c)  {
+	U8	h;		// next head ptr
+	bit	EA_save;
 
-	// output character
-	while(!qTI0B){			// wait for tx buffer to clear
-		continue;
+	h = txd_hptr + 1;
+	if(h == TXD_BUFF_END){
+		h = 0;
 	}
-	qTI0B = 0;
-	SBUF0 = c;
+	if(h == txd_tptr){			// buffer full
+		if(txd_mode != TXD_BLOCK){
+			txd_ovf = 1;		// discard chr
+			return (c);
+		}
+		while(h == txd_tptr){	// wait for intr to pull a chr
+			poll_port();		// ..PTT/FSEL are serviced while waiting
+		}
+	}
+	txd_buff[txd_hptr] = c;
+	txd_hptr = h;
+	EA_save = EA;				// prohibit intrpts (the RX intr can start an XON/XOFF)
+	EA = 0;
+	if(!txd_run){
+		txd_run = 1;
+		TI0 = 1;				// prime the pump (intr sends the 1st chr)
+	}
+	EA = EA_save;				// re-set intrpt enable
 	return (c);
 }
 
@@ -100,6 +299,13 @@ char getch00(void)
 		rxd_crcnt--;					// clear flag
 		EA = EA_save;					// re-set intrpt enable
 	}
+	if(rxd_xoff && (RXD_FILL <= RXD_LOWAT)){
+		EA_save = EA;					// prohibit intrpts
+		EA = 0;
+		rxd_xoff = 0;
+		TXD_CTL(XON);					// let the host resume
+		EA = EA_save;					// re-set intrpt enable
+	}
 	return c;
 }
 
@@ -194,9 +400,13 @@ char gotcr(void)
 
 void putss (char* string)
 {
+	txd_ovf = 0;
 	while(*string){
 		if(*string == '\n') putch('\r');
 		putch(*string++);
+		if(txd_ovf && (txd_mode == TXD_TRUNC)){
+			break;					// buffer full, drop the rest of the string
+		}
 	}
 	return;
 }
@@ -206,18 +416,8 @@ void putss (char* string)
 //-----------------------------------------------------------------------------
 //
 // UART intr.  Captures RX data and places into circular buffer
-//	For TX, if mode = buffered, the intr will process the TX buffer until empty.
-//	To send data, fill the tx buffer, then kick-start the transmit process as follows:
-//
-//		c = txd_buff[txd_tptr++];		// get 1st chr of buffered data
-//		if(txd_tptr >= TXD_BUFF_END){
-//			txd_tptr = 0;				// roll-over headptr
-//		}
-//		SBUF0 = c;						// prime the pump (kick-start the TX output)
-//		TI0B = 0;
-//
-//	If not in buffered mode, use reflection register to pass TXD empty status back to
-//	putchar.
+//	For TX, the intr sends chrs from txd_buff[] until it is empty, then clears txd_run.
+//	putch() kick-starts an idle transmitter by setting TI0.
 //
 //
 //-----------------------------------------------------------------------------
@@ -227,7 +427,7 @@ void putss (char* string)
 // UART1 rx intr.  Captures RX data and places into circular buffer
 //
 
-void rxd_intr(void) interrupt 4
+void rxd_intr(void) interrupt 4 using 2
 {
 /* buffer registers repeated here for reference ... !! DO NOT UNCOMMENT !!
 S8   rxd_buff[10];					// rx data buffer
@@ -236,44 +436,68 @@ U8   rxd_tptr = 0;					// rx buf tail ptr
 U8   rxd_stat = 0;					// rx buff status*/
 
 	char	c;
+	U8		h;
 
 	if(TI0){
-		qTI0B = 1;								// set TX reflection flag
 		TI0 = 0;
+		if(txd_ctl){
+			SBUF0 = txd_ctl;					// flow control chr goes first
+			txd_ctl = 0;
+		}else if(txd_tptr != txd_hptr){
+			SBUF0 = txd_buff[txd_tptr];			// send next chr
+			if(++txd_tptr == TXD_BUFF_END){
+				txd_tptr = 0;
+			}
+			if(((txd_hptr - txd_tptr) & (TXD_BUFF_END - 1)) == TXD_WAKE){
+				task_rdy |= TSK_OUT;			// room to refill
+			}
+		}else{
+			txd_run = 0;						// buffer empty, TX idle
+			task_rdy |= TSK_OUT;
+		}
 	}
 	if(RI0){
+		RI0 = 0;								// clear intr flag
 		c = SBUF0;
-		if((c == '\n') || (c == ESC)){			// don't capture linefeeds or ESC
-			if(c == ESC){
-				rxd_hptr = 0;					// if ESC, re-init serial buffer
-				rxd_tptr = 0;
-				rxd_crcnt = 0;
-				rxd_stat = RXD_ESC;
+		if(rxd_raw){
+			h = rxd_hptr;						// binary data, store all
+			rxd_buff[h] = c;
+			h = (h + 1) & (RXD_BUFF_END - 1);
+			rxd_hptr = h;
+			if(h == rxd_tptr){
+				rxd_stat |= RXD_ERR;
 			}
+		}else if(c == ESC){
+			rxd_hptr = 0;						// if ESC, re-init serial buffer
+			rxd_tptr = 0;
+			rxd_crcnt = 0;
+			rxd_stat = RXD_ESC;
 		}else{
-			rxd_buff[rxd_hptr] = c;
-			if(rxd_buff[rxd_hptr] == '\r'){
-				rxd_crcnt++;					// set CR rcvd flag
-			}
-			if(rxd_buff[rxd_hptr] == '\b'){
-				if(rxd_hptr != rxd_tptr){		// only process BS if buffer is not empty
-					rxd_stat |= RXD_BS;			// set BS rcvd flag
-					if(rxd_hptr == 0){			// decrement headptr and rollunder if needed
-						rxd_hptr = RXD_BUFF_END;
+			if(c != '\n'){						// don't capture linefeeds
+				h = rxd_hptr;
+				if(c == '\b'){
+					if(h != rxd_tptr){			// only process BS if buffer is not empty
+						rxd_stat |= RXD_BS;		// set BS rcvd flag
+						rxd_hptr = (h - 1) & (RXD_BUFF_END - 1);	// decrement headptr (with rollunder)
+					}
+				}else{
+					rxd_buff[h] = c;
+					if(c == '\r'){
+						rxd_crcnt++;			// set CR rcvd flag
+					}
+					h = (h + 1) & (RXD_BUFF_END - 1);	// increment headptr (with rollover)
+					rxd_hptr = h;
+					if(h == rxd_tptr){			// check for overflow, flag error if true
+						rxd_stat |= RXD_ERR;
+					}
+					if(rxd_flow && !rxd_xoff && (RXD_FILL >= RXD_HIWAT)){
+						rxd_xoff = 1;
+						TXD_CTL(XOFF);			// hold off the host
 					}
-					rxd_hptr--;
-				}
-			}else{
-	//			rxd_stat |= RXD_CHAR;
-				if(++rxd_hptr == RXD_BUFF_END){	// increment headptr and rollover if needed
-					rxd_hptr = 0;
 				}
 			}
-			if(rxd_hptr == rxd_tptr){			// check for overflow, flag error if true
-				rxd_stat |= RXD_ERR;
-			}
 		}
-		RI0 = 0;								// clear intr flag
+		task_rdy |= TSK_CMD;					// wake the cmd task
 	}
 	return;
 }
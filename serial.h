@@ -30,6 +30,16 @@
 
 void init_serial(void);
 char putch(const char c);
+U8 set_txmode(U8 mode);
+U8 txd_free(void);
+void set_baud(U8 b);
+U8 rxd_ovf(U8 clr);
+void set_flow(U8 on);
+U8 rxd_crpend(void);
+void set_rawrx(U8 on);
+U8 rxd_cnt(void);
+U8 rxd_peek(U8 i);
+void rxd_drop(U8 n);
 void cleanline(void);
 char anych00(void);
 char getch00(void);
@@ -45,4 +55,23 @@ void putss (char *string);
 
 #define NOTBUF 0
 #define TBUF 1
-#define	ESC	27
\ No newline at end of file
+// txd_buff full policy (set_txmode())
+#define	TXD_DROP	0			// discard chrs that don't fit
+#define	TXD_BLOCK	1			// wait for space
+#define	TXD_TRUNC	2			// discard the rest of the putss() string
+#define	TXD_POLICY	TXD_BLOCK	// power-on policy
+#define	ESC	27
+#define	RXD_MAX	63				// max chrs in rxd_buff
+#define	XON		0x11
+#define	XOFF	0x13
+// baud rates (set_baud())
+#define	BAUD_9600	0			// power-on rate (Timer_Init())
+#define	BAUD_19200	1
+#define	BAUD_57600	2
+#define	BAUD_115200	3
+#define	NUM_BAUD	4
+#define	BAUD_TMO	MS10000		// revert to 9600 if no valid cmd at the new rate in this time
+
+#ifndef SERIAL_INCL
+extern U16 code baud100[NUM_BAUD];
+#endif
\ No newline at end of file
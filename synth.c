@@ -0,0 +1,175 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: synth.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the ADF4351 register synthesis module.  syn_calc()
+ *             works out R0-R5 for an output frequency in fixed point (10 Hz
+ *             units, 32 bit math), so that a channel doesn't have to be
+ *             pre-computed on a PC.
+ *
+ *			   fPFD = SYN_REF / R (R is the smallest that keeps fPFD <= 32 MHz).  The RF divider
+ *			   (1 - 64) puts the VCO in 2.2 - 4.4 GHz, and the VCO (fundamental feedback) is
+ *			   fPFD * (INT + FRAC / MOD).  FRAC / MOD is the exact fraction if that fits in MOD
+ *			   (<= 4095), else MOD = fPFD / spacing and FRAC is rounded to the nearest step.
+ *			   Either way, FRAC / MOD is reduced (MOD >= 2).  The band select clock
+ *			   divider keeps the band select clock <= 125 KHz.  The other fields are the same
+ *			   as in the default channel table (channels.c).
+ *
+ *			   syn_freq() and syn_opt() go the other way (regs to frequency and opt), for the
+ *			   frequency CH record format (CH_FREQ, chfreq.c).
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Added the MTLD and power down opt flags, syn_freq(), and syn_opt().
+ *						Only built if SYN_CMD = 1 or CH_FREQ = 1.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#define SYNTH_INCL
+#include "synth.h"
+
+#if (SYN_CMD == 1) || (CH_FREQ == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	SYN_PFDMAX	3200000L		// max fPFD (frac-N)
+#define	SYN_RCNT	((SYN_REF + SYN_PFDMAX - 1) / SYN_PFDMAX)	// R counter
+#define	SYN_PFD		(SYN_REF / SYN_RCNT)
+#define	SYN_BSDIV	((SYN_PFD + 12499L) / 12500L)	// band select clock divider (125 KHz)
+#define	SYN_VCOMIN	220000000L		// VCO range
+#define	SYN_VCOMAX	440000000L
+#define	SYN_PRE45	360000000L		// max VCO for the 4/5 prescaler
+
+#define	R1_PRE89	0x08000000L		// R1: 8/9 prescaler
+#define	R1_PHASE	0x00008000L		// R1: phase = 1
+#define	R2_BASE		0x00000E42L		// R2: CP = 2.5 mA, PD polarity +
+#define	R3_BASE		0x000004B3L		// R3: clock divider = 150
+#define	R4_BASE		0x00800024L		// R4: fundamental feedback, RF out enabled
+#define	R5_BASE		0x00580005L		// R5: digital lock detect
+#define	R2_PD		0x00000020L		// R2: power down
+#define	R4_MTLD		0x00000400L		// R4: mute till lock detect
+
+#if (SYN_BSDIV > 255) || ((SYN_REF % SYN_RCNT) != 0)
+#error "SYN_REF isn't supported"
+#endif
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+U32 gcd32(U32 a, U32 b);
+
+//-----------------------------------------------------------------------------
+// syn_calc() calculates the ADF4351 regs for output frequency f w/ channel spacing spc (both
+//	10 Hz units) and opt (output power 0 - 3, SYN_MTLD, SYN_PD), into regs[0] (R0) thru
+//	regs[5] (R5).  spc is only used if f needs MOD > 4095.  regs[] is not changed unless
+//	SYN_OK is returned.
+//-----------------------------------------------------------------------------
+//
+U8 syn_calc(U32 f, U32 spc, U8 opt, U32 idata * regs){
+	U32	vco;
+	U32	rem;			// VCO - INT * fPFD
+	U32	g;
+	U16	n;				// INT
+	U16	frac;
+	U16	mod;
+	U8	d;				// RF divider select (divide by 2^d)
+
+	if((f > SYN_VCOMAX) || (opt & ~(SYN_PWRM | SYN_MTLD | SYN_PD))) return SYN_EFREQ;
+	vco = f;
+	for(d=0; vco<SYN_VCOMIN; d++){
+		if(d == 6) return SYN_EFREQ;		// below 2.2 GHz / 64
+		vco <<= 1;
+	}
+	n = vco / SYN_PFD;
+	rem = vco % SYN_PFD;
+	g = gcd32(SYN_PFD, rem);
+	if((SYN_PFD / g) <= 4095){
+		mod = SYN_PFD / g;					// exact
+		frac = rem / g;
+	}else{
+		if((spc == 0) || ((SYN_PFD / spc) < 2) || ((SYN_PFD / spc) > 4095)) return SYN_ESPC;
+		mod = SYN_PFD / spc;
+		frac = (rem + (spc / 2)) / spc;		// nearest step
+		if(frac >= mod){
+			frac = 0;						// rounded up to the next INT
+			n++;
+		}
+		g = gcd32(mod, frac);
+		frac /= g;
+		mod /= g;
+	}
+	if(mod < 2) mod = 2;					// (FRAC = 0)
+	if(n < ((vco > SYN_PRE45) ? 75 : 23)) return SYN_EFREQ;
+	regs[0] = ((U32)n << 15) | ((U32)frac << 3);
+	regs[1] = ((vco > SYN_PRE45) ? R1_PRE89 : 0) | R1_PHASE | ((U32)mod << 3) | 1;
+	regs[2] = R2_BASE | ((U32)SYN_RCNT << 14) | ((opt & SYN_PD) ? R2_PD : 0);
+	regs[3] = R3_BASE;
+	regs[4] = R4_BASE | ((U32)d << 20) | ((U32)SYN_BSDIV << 12) | ((U32)(opt & SYN_PWRM) << 3) |
+		((opt & SYN_MTLD) ? R4_MTLD : 0);
+	regs[5] = R5_BASE;
+	return SYN_OK;
+}
+
+//-----------------------------------------------------------------------------
+// syn_freq() returns the output frequency (10 Hz units, rounded) of the ADF4351 regs at
+//	regs[0] (R0) thru regs[5] (R5), at the SYN_REF fPFD.  returns 0 if MOD is 0.
+//-----------------------------------------------------------------------------
+//
+U32 syn_freq(U32 idata * regs){
+	U32	vco;
+	U16	frac;
+	U16	mod;
+	U8	d;
+
+	frac = (U16)(regs[0] >> 3) & 0x0fff;
+	mod = (U16)(regs[1] >> 3) & 0x0fff;
+	d = (U8)(regs[4] >> 20) & 0x07;
+	if(mod == 0) return 0;
+	// fPFD * FRAC / MOD, split so that it fits in 32 bits
+	vco = ((regs[0] >> 15) & 0xffff) * SYN_PFD;
+	vco += (U32)frac * (SYN_PFD / mod);
+	vco += (((U32)frac * (SYN_PFD % mod)) + (mod / 2)) / mod;
+	return (vco + ((1L << d) >> 1)) >> d;
+}
+
+//-----------------------------------------------------------------------------
+// syn_opt() returns the syn_calc() opt (power and flags) of the ADF4351 regs at regs[]
+//-----------------------------------------------------------------------------
+//
+U8 syn_opt(U32 idata * regs){
+	U8	opt;
+
+	opt = (U8)(regs[4] >> 3) & SYN_PWRM;
+	if(regs[4] & R4_MTLD) opt |= SYN_MTLD;
+	if(regs[2] & R2_PD) opt |= SYN_PD;
+	return opt;
+}
+
+//-----------------------------------------------------------------------------
+// gcd32() returns the greatest common divisor of a and b (a if b = 0)
+//-----------------------------------------------------------------------------
+//
+U32 gcd32(U32 a, U32 b){
+	U32	t;
+
+	while(b != 0){
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: synth.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the ADF4351 register synthesis.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						syn_calc() takes option flags w/ the power.  Added syn_freq() and syn_opt().
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 syn_calc(U32 f, U32 spc, U8 opt, U32 idata * regs);
+U32 syn_freq(U32 idata * regs);
+U8 syn_opt(U32 idata * regs);
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+// syn_calc() returns
+#define	SYN_OK		0
+#define	SYN_EFREQ	1				// frequency (or power) out of range
+#define	SYN_ESPC	2				// channel spacing doesn't give a valid MOD (2 - 4095)
+// syn_calc() opt: output power (0 - 3) | flags
+#define	SYN_PWRM	0x03			// output power
+#define	SYN_MTLD	0x04			// mute till lock detect
+#define	SYN_PD		0x08			// PLL powered down
@@ -0,0 +1,174 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: timer.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the ms timer service.  Timer2_ISR runs a 1 ms tick that
+ *             keeps the uptime count and services NUM_TMR software timers.
+ *             Each timer is one-shot or periodic, sets its bit in tmr_exp when
+ *             it expires, and can make a task ready (see tmr_wake[]).
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Timer2_ISR moved here from main.c.  waittimer, dbounce_tmr, and cmd_tmr
+ *							are now timers TMR_WAIT, TMR_PORT, and TMR_CMD.  ms_tick is replaced by the
+ *							32b ms_uptime.
+ *						Added TMR_BAUD.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#define TIMER_INCL
+#include "timer.h"
+
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U32	ms_uptime;						// ms since POR
+U16 idata tmr_cnt[NUM_TMR];			// ms left (0 = stopped)
+U16 idata tmr_rld[NUM_TMR];			// period (0 = one-shot)
+U8	tmr_exp;						// expired flags (bit n = timer n)
+// task made ready when a timer expires (must track the TMR_xxx defines in timer.h)
+U8 code tmr_wake[NUM_TMR] = {
+	TSK_PORT,						// TMR_PORT
+	TSK_CMD,						// TMR_CMD
+	0,								// TMR_WAIT
+	TSK_CMD							// TMR_BAUD
+};
+
+//-----------------------------------------------------------------------------
+// init_timer() initializes the timer service
+//-----------------------------------------------------------------------------
+//
+void init_timer(void){
+	U8	i;
+
+	for(i=0; i<NUM_TMR; i++){
+		tmr_cnt[i] = 0;
+		tmr_rld[i] = 0;
+	}
+	tmr_exp = 0;
+	ms_uptime = 0;
+}
+
+//-----------------------------------------------------------------------------
+// tmr_start() starts timer n.  It expires in "ms" ms (1 ms min), then every
+//	"period" ms.  period = 0 for one-shot.  Clears the expired flag.
+//-----------------------------------------------------------------------------
+//
+void tmr_start(U8 n, U16 ms, U16 period){
+	bit	EA_save;
+
+	if(ms == 0) ms = 1;
+	EA_save = EA;					// prohibit intrpts
+	EA = 0;
+	tmr_cnt[n] = ms;
+	tmr_rld[n] = period;
+	tmr_exp &= ~(1 << n);
+	EA = EA_save;					// re-set intrpt enable
+}
+
+//-----------------------------------------------------------------------------
+// tmr_stop() stops timer n and clears its expired flag
+//-----------------------------------------------------------------------------
+//
+void tmr_stop(U8 n){
+	bit	EA_save;
+
+	EA_save = EA;					// prohibit intrpts
+	EA = 0;
+	tmr_cnt[n] = 0;
+	tmr_rld[n] = 0;
+	tmr_exp &= ~(1 << n);
+	EA = EA_save;					// re-set intrpt enable
+}
+
+//-----------------------------------------------------------------------------
+// tmr_run() returns 1 if timer n is running
+//-----------------------------------------------------------------------------
+//
+U8 tmr_run(U8 n){
+	U8	i;
+	bit	EA_save;
+
+	EA_save = EA;					// tmr_cnt is a 16b intr var
+	EA = 0;
+	i = (tmr_cnt[n] != 0);
+	EA = EA_save;
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// tmr_done() returns 1 if timer n has expired since the last call (clears the flag)
+//-----------------------------------------------------------------------------
+//
+U8 tmr_done(U8 n){
+	U8	m;
+
+	m = 1 << n;
+	if(tmr_exp & m){
+		tmr_exp &= ~m;				// ANL direct is atomic wrt the ISR
+		return 1;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// get_uptime() returns ms since POR
+//-----------------------------------------------------------------------------
+//
+U32 get_uptime(void){
+	U32	t;
+	bit	EA_save;
+
+	EA_save = EA;					// prohibit intrpts
+	EA = 0;
+	t = ms_uptime;
+	EA = EA_save;
+	return t;
+}
+
+//-----------------------------------------------------------------------------
+// Timer2_ISR
+//-----------------------------------------------------------------------------
+//
+// Called when timer 2 overflows (NORM mode):
+//      updates app timers @ 1ms rate
+//		rate = (sysclk/12) / (65536 - TH:L)
+//
+//-----------------------------------------------------------------------------
+
+void Timer2_ISR(void) interrupt 5 using 2
+{
+	U8	i;
+	U8	m;
+
+    TF2H = 0;                           // Clear Timer2 interrupt flag
+	ms_uptime++;						// free-running ms count
+	for(i=0, m=0x01; i<NUM_TMR; i++, m<<=1){
+		if(tmr_cnt[i] != 0){
+			if(--tmr_cnt[i] == 0){
+				tmr_cnt[i] = tmr_rld[i];	// periodic timers restart
+				tmr_exp |= m;
+				task_rdy |= tmr_wake[i];
+			}
+		}
+	}
+}
+
+//**************
+// End Of File
+//**************
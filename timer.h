@@ -0,0 +1,51 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: timer.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the ms timer service.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+// timer assignments (add a tmr_wake[] entry in timer.c for each)
+#define	TMR_PORT	0				// FSEL/PTT settle (DBOUNCE_MS), wakes TSK_PORT
+#define	TMR_CMD		1				// cmd timeout/delay, wakes TSK_CMD
+#define	TMR_WAIT	2				// wait()
+#define	TMR_BAUD	3				// baud rate fallback (BAUD_TMO), wakes TSK_CMD
+#define	NUM_TMR		4
+
+// (re)start a one-shot timer from an ISR at Timer2 priority.  Main code uses tmr_start().
+#define	TMR_ISR_START(n, ms)	{ tmr_cnt[n] = (ms); tmr_exp &= ~(1 << (n)); }
+
+//------------------------------------------------------------------------------
+// extern defines
+//------------------------------------------------------------------------------
+
+#ifndef TIMER_INCL
+extern U16 idata tmr_cnt[NUM_TMR];
+extern U8 tmr_exp;
+#endif
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+void init_timer(void);
+void tmr_start(U8 n, U16 ms, U16 period);
+void tmr_stop(U8 n);
+U8 tmr_run(U8 n);
+U8 tmr_done(U8 n);
+U32 get_uptime(void);
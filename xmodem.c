@@ -0,0 +1,405 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: xmodem.c
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the XMODEM-CRC transfer module for the channel image
+ *             (24 * NUM_CHAN bytes at CHAN_ADDR).  There is no RAM for a
+ *             128 byte block buffer, so received blocks are staged in the
+ *             scratch sector as the bytes arrive, and copied to the channels
+ *             only after the block CRC checks.  The transfer runs as a cmd
+ *             continuation: xm_poll() is called from cmd_task(), and xm_out()
+ *             from out_task().
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						Table CRC is re-calculated after a receive.
+ *						Send reads the CHs thru chs_chan() (CH_LOG builds have no flat image to receive into).
+ *						Only built if XM_CMD = 1.
+ *						RX blocks are staged in the scratch sector and written after the CRC checks, and
+ *							xm_start() checks that the channels are erased before asking for the image.
+ *
+ *******************************************************************/
+
+#include "c8051F520.h"
+#include "typedef.h"
+#include "init.h"
+#include "serial.h"
+#include "crc.h"
+#include "flash.h"
+#include "channels.h"
+#include "timer.h"
+#include "chstore.h"
+#define XMODEM_INCL
+#include "xmodem.h"
+
+#if (XM_CMD == 1)
+//------------------------------------------------------------------------------
+// local defines
+//------------------------------------------------------------------------------
+
+#define	SOH			0x01
+#define	EOT			0x04
+#define	ACK			0x06
+#define	NAK			0x15
+#define	CAN			0x18
+#define	XM_PAD		0x1A			// fill for the part of the last block past the image
+#define	XM_BLKSZ	128
+#define	XM_CRCH		(XM_BLKSZ + 3)	// pkt index of CRC16 msb (SOH, blk, ~blk, data[128], CRCH, CRCL)
+#define	XM_LEN		(24 * NUM_CHAN)	// channel image size
+#define	XM_TRIES	10				// max NAKs/timeouts per block
+#define	XM_TMO		(3000/MS_PER_TIC)	// RX: "C"/byte timeout
+#define	XM_ATMO		MS10000			// TX: ACK timeout
+#define	XM_STMO		MS20000			// TX: wait for the receiver to start ("C")
+#define	XM_SLICE	32				// max RX bytes processed (or staged bytes copied) per slice
+// RX staging slots in the scratch sector: past the scratch journal (chstore.c, so boot can't
+//	take a staged block for a sector 0 re-write) and short of the lock byte (LOCK_ADDR)
+#define	XM_SCR		(SCRATCH_ADDR + (CHAN_ADDR - SECT00_ADDR))
+#define	XM_NSLOT	((SCRATCH_ADDR + SECTOR_SIZE - 1 - XM_SCR) / XM_BLKSZ)
+#if (XM_NSLOT == 0) || ((XM_SCR + (XM_NSLOT * XM_BLKSZ)) > LOCK_ADDR)
+#error "XMODEM staging slots don't fit in the scratch sector"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local Variable Declarations
+//-----------------------------------------------------------------------------
+
+U8	xm_mode;						// XM_RX or XM_TX
+U8	xm_blk;							// block# expected (RX) or being sent (TX)
+U8	xm_rblk;						// RX: block# of the pkt being received
+U8	xm_n;							// pkt byte index
+U8	xm_try;							// retry count
+U16	xm_crc;							// CRC16 of the pkt data
+U16	xm_rcrc;						// RX: pkt CRC16
+bit	xm_hdr;							// RX: pkt header error (don't write)
+bit	xm_dup;							// RX: repeat of the last block (don't write)
+bit	xm_cpy;							// RX: copying the staged block to the channels
+U8	xm_slot;						// RX: staging slot of the pkt being received
+U8	xm_ci;							// RX: staged block copy index
+bit	xm_go;							// TX: receiver has started
+bit	xm_snd;							// TX: pkt being sent (xm_out())
+bit	xm_eot;							// TX: EOT sent
+
+//------------------------------------------------------------------------------
+// local fn declarations
+//------------------------------------------------------------------------------
+
+U8 xm_rxpoll(void);
+U8 xm_commit(void);
+void xm_nextslot(void);
+U8 xm_txpoll(void);
+void xm_cancel(void);
+
+//-----------------------------------------------------------------------------
+// xm_start() starts an XMODEM-CRC transfer (mode = XM_RX or XM_TX).  For RX, the
+//	channels must be erased: returns 1 (not started) if they aren't, else 0.
+//-----------------------------------------------------------------------------
+//
+U8 xm_start(U8 mode){
+	U16	off;
+
+	if(mode == XM_RX){
+		for(off=0; off<XM_LEN; off++){
+			if(*(U8 code *)(CHAN_ADDR + off) != 0xff) return 1;
+		}
+		erase_flash((U8 xdata *)SCRATCH_ADDR);
+	}
+
+	xm_mode = mode;
+	xm_blk = 1;
+	xm_n = 0;
+	xm_try = 0;
+	xm_hdr = 0;
+	xm_dup = 0;
+	xm_cpy = 0;
+	xm_slot = 0;
+	xm_go = 0;
+	xm_snd = 0;
+	xm_eot = 0;
+	set_rawrx(1);
+	if(mode == XM_RX){
+		putch('C');						// ask for CRC mode
+		tmr_start(TMR_CMD, XM_TMO, 0);
+	}else{
+		tmr_start(TMR_CMD, XM_STMO, 0);
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// xm_poll() runs one slice of the transfer.  Returns XM_BUSY, XM_DONE, or XM_FAIL.
+//	On DONE/FAIL, the raw RX mode is turned off.
+//-----------------------------------------------------------------------------
+//
+U8 xm_poll(void){
+	U8	i;
+
+	if(xm_mode == XM_RX){
+		i = xm_rxpoll();
+	}else{
+		i = xm_txpoll();
+	}
+	if(i != XM_BUSY){
+		tmr_stop(TMR_CMD);
+		set_rawrx(0);
+		if(xm_mode == XM_RX){
+			chs_recalc();					// FLASH was written directly
+		}
+	}
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// xm_rxpoll() processes up to XM_SLICE received bytes
+//-----------------------------------------------------------------------------
+//
+U8 xm_rxpoll(void){
+	U8	i;
+	U8	c;
+
+	if(xm_cpy){
+		return xm_commit();						// the sender waits for the ACK
+	}
+	for(i=0; (i<XM_SLICE) && rxd_cnt(); i++){
+		c = getch00();
+		if(xm_n == 0){
+			if(c == EOT){
+				putch(ACK);
+				return XM_DONE;
+			}
+			if(c == CAN){
+				return XM_FAIL;
+			}
+			if(c != SOH){
+				continue;						// noise between pkts
+			}
+		}else if(xm_n == 1){
+			xm_rblk = c;
+		}else if(xm_n == 2){
+			xm_hdr = ((U8)~c != xm_rblk);
+			xm_dup = (xm_rblk == (U8)(xm_blk - 1));
+			if(!xm_hdr && !xm_dup && (xm_rblk != xm_blk)){
+				xm_cancel();					// lost sync
+				return XM_FAIL;
+			}
+			xm_crc = 0;
+		}else if(xm_n < XM_CRCH){
+			xm_crc = calcrc(c, xm_crc);
+			if(!xm_hdr && !xm_dup && (c != 0xff)){
+				wr_flash(c, (U8 xdata *)(XM_SCR + (xm_slot * XM_BLKSZ) + (xm_n - 3)));
+			}
+		}else if(xm_n == XM_CRCH){
+			xm_rcrc = (U16)c << 8;
+		}else{
+			xm_rcrc |= c;
+			xm_n = 0;							// pkt complete
+			if(xm_hdr || (xm_crc != xm_rcrc)){
+				if(++xm_try > XM_TRIES){
+					xm_cancel();
+					return XM_FAIL;
+				}
+				if(!xm_hdr && !xm_dup) xm_nextslot();	// (the slot was written)
+				putch(NAK);						// re-send
+			}else{
+				if(!xm_dup){
+					xm_cpy = 1;					// copy it, then ACK
+					xm_ci = 0;
+					task_rdy |= TSK_CMD;
+					return XM_BUSY;
+				}
+				putch(ACK);
+				xm_try = 0;
+			}
+			continue;
+		}
+		xm_n++;
+	}
+	if(i != 0){
+		tmr_start(TMR_CMD, XM_TMO, 0);			// data is flowing
+	}
+	if(rxd_cnt()){
+		task_rdy |= TSK_CMD;					// more to do
+	}else{
+		if(tmr_done(TMR_CMD)){
+			if(++xm_try > XM_TRIES){
+				xm_cancel();
+				return XM_FAIL;
+			}
+			if((xm_n > 3) && !xm_hdr && !xm_dup) xm_nextslot();	// (a partial pkt was staged)
+			xm_n = 0;
+			if(xm_blk == 1){
+				putch('C');						// sender not started, ask again
+			}else{
+				putch(NAK);
+			}
+			tmr_start(TMR_CMD, XM_TMO, 0);
+		}
+	}
+	return XM_BUSY;
+}
+
+//-----------------------------------------------------------------------------
+// xm_commit() copies up to XM_SLICE bytes of the staged block to the channels, and ACKs the
+//	block when it is done.  Fails if the FLASH doesn't read back (the CHs weren't erased).
+//-----------------------------------------------------------------------------
+//
+U8 xm_commit(void){
+	U8	i;
+	U8	c;
+	U16	off;			// image offset
+
+	off = ((U16)(xm_blk - 1) * XM_BLKSZ) + xm_ci;
+	for(i=0; (i<XM_SLICE) && (xm_ci<XM_BLKSZ) && (off<XM_LEN); i++){
+		c = *(U8 code *)(XM_SCR + (xm_slot * XM_BLKSZ) + xm_ci);
+		if(c != 0xff) wr_flash(c, (U8 xdata *)(CHAN_ADDR + off));
+		if(*(U8 code *)(CHAN_ADDR + off) != c){
+			xm_cancel();
+			return XM_FAIL;
+		}
+		xm_ci++;
+		off++;
+	}
+	if((xm_ci < XM_BLKSZ) && (off < XM_LEN)){
+		task_rdy |= TSK_CMD;					// more to do
+		return XM_BUSY;
+	}
+	xm_cpy = 0;
+	xm_nextslot();
+	putch(ACK);
+	xm_blk++;
+	xm_try = 0;
+	tmr_start(TMR_CMD, XM_TMO, 0);
+	return XM_BUSY;
+}
+
+//-----------------------------------------------------------------------------
+// xm_nextslot() moves to the next staging slot.  The scratch sector is erased when they are
+//	used up (between pkts: the sender is waiting for the ACK/NAK).
+//-----------------------------------------------------------------------------
+//
+void xm_nextslot(void){
+
+	if(++xm_slot == XM_NSLOT){
+		erase_flash((U8 xdata *)SCRATCH_ADDR);
+		xm_slot = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// xm_txpoll() processes receiver responses
+//-----------------------------------------------------------------------------
+//
+U8 xm_txpoll(void){
+	U8	c;
+	bit	resend;
+
+	resend = 0;
+	while(rxd_cnt()){
+		c = getch00();
+		if(c == CAN){
+			return XM_FAIL;
+		}
+		if(xm_snd){
+			continue;							// no response is due until the pkt is sent
+		}
+		if(!xm_go){
+			if(c == 'C'){
+				xm_go = 1;
+				resend = 1;						// send 1st block
+			}
+			continue;
+		}
+		if(c == ACK){
+			if(xm_eot){
+				return XM_DONE;
+			}
+			xm_blk++;
+			xm_try = 0;
+			resend = 1;
+		}
+		if(c == NAK){
+			if(++xm_try > XM_TRIES){
+				xm_cancel();
+				return XM_FAIL;
+			}
+			resend = 1;
+		}
+	}
+	if(!resend && !xm_snd && tmr_done(TMR_CMD)){
+		if(!xm_go || (++xm_try > XM_TRIES)){
+			xm_cancel();
+			return XM_FAIL;
+		}
+		resend = 1;								// no response, send it again
+	}
+	if(resend){
+		if(((U16)(xm_blk - 1) * XM_BLKSZ) >= XM_LEN){
+			xm_eot = 1;
+			putch(EOT);							// image complete
+			tmr_start(TMR_CMD, XM_ATMO, 0);
+		}else{
+			xm_n = 0;
+			xm_crc = 0;
+			xm_snd = 1;
+			task_rdy |= TSK_OUT;				// xm_out() sends the pkt
+		}
+	}
+	return XM_BUSY;
+}
+
+//-----------------------------------------------------------------------------
+// xm_out() sends the current TX pkt as TX buffer space allows (called by out_task())
+//-----------------------------------------------------------------------------
+//
+void xm_out(void){
+	U8	c;
+	U16	off;			// image offset
+
+	while(xm_snd && txd_free()){
+		if(xm_n == 0){
+			c = SOH;
+		}else if(xm_n == 1){
+			c = xm_blk;
+		}else if(xm_n == 2){
+			c = ~xm_blk;
+		}else if(xm_n < XM_CRCH){
+			off = ((U16)(xm_blk - 1) * XM_BLKSZ) + (xm_n - 3);
+			if(off < XM_LEN){
+				c = chs_chan(off / 24)[off % 24];
+			}else{
+				c = XM_PAD;
+			}
+			xm_crc = calcrc(c, xm_crc);
+		}else if(xm_n == XM_CRCH){
+			c = (U8)(xm_crc >> 8);
+		}else{
+			c = (U8)(xm_crc & 0xff);
+			xm_snd = 0;							// pkt sent, wait for ACK/NAK
+			tmr_start(TMR_CMD, XM_ATMO, 0);
+		}
+		putch(c);
+		xm_n++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// xm_cancel() aborts the transfer at the other end
+//-----------------------------------------------------------------------------
+//
+void xm_cancel(void){
+
+	putch(CAN);
+	putch(CAN);
+}
+
+#endif
+
+//**************
+// End Of File
+//**************
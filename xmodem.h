@@ -0,0 +1,38 @@
+/*************************************************************************
+ *********** COPYRIGHT (c) 2026 by Joseph Haas (DBA FF Systems)  *********
+ *
+ *  File name: xmodem.h
+ *
+ *  Module:    Control
+ *
+ *  Summary:   This is the header file for the XMODEM-CRC transfer module.
+ *
+ *******************************************************************/
+
+
+/********************************************************************
+ *  File scope declarations revision history:
+ *    10-17-26 jmh:  creation date
+ *						xm_start() returns 1 if the CHs aren't erased (XM_RX).
+ *
+ *******************************************************************/
+
+//------------------------------------------------------------------------------
+// public Function Prototypes
+//------------------------------------------------------------------------------
+
+U8 xm_start(U8 mode);
+U8 xm_poll(void);
+void xm_out(void);
+
+//------------------------------------------------------------------------------
+// global defines
+//------------------------------------------------------------------------------
+
+// xm_start() modes
+#define	XM_RX		0				// receive the channel image into FLASH
+#define	XM_TX		1				// send the channel image
+// xm_poll() status
+#define	XM_BUSY		0
+#define	XM_DONE		1
+#define	XM_FAIL		2